@@ -11,16 +11,36 @@ static const unsigned int gappoh    = 10;       /* horiz outer gap between windo
 static const unsigned int gappov    = 15;       /* vert outer gap between windows and screen edge */
 static int smartgaps                = 1;        /* 1 means no outer gap when there is only one window */
 static const int swallowfloating    = 1;        /* 1 means swallow floating windows by default */
+static const unsigned int swallowgrace = 50;    /* ms a new window waits unmapped for its swallow, 0 maps at once */
+static const int seamlessrestart = 0;         /* 1 means the old bars stay up until the restarted dwm has drawn its own */
+static const char *rcfile        = "dwm/dwmrc"; /* keys, rules, colors, gaps under $XDG_CONFIG_HOME, reloaded on change; NULL to disable */
+static const char *layoutdir     = "dwm/layouts"; /* layout plugins (*.so) under $XDG_CONFIG_HOME, see layout.h; NULL to disable */
 static int showbar                  = 1;        /* 0 means no bar */
 static const int showtitle          = 1;        /* 0 means no title */
 static const int showtags           = 1;        /* 0 means no tags */
 static const int showlayout         = 1;        /* 0 means no layout indicator */
 static const int showstatus         = 1;        /* 0 means no status bar */
+static const char *statussock       = "dwm-status.sock"; /* status block socket in $XDG_RUNTIME_DIR, NULL to disable */
+static const char *ipcsock          = "dwm.sock"; /* command socket in $XDG_RUNTIME_DIR for dwm-msg, NULL to disable */
+static const char *statename        = "dwm-state"; /* shared memory snapshot /<name>-<uid>-<display>, see dwmstate.h; NULL to disable */
+static const int statusengine       = 0;        /* 1 means run statusblocks inside dwm */
 static const int showfloating       = 0;        /* 0 means no floating indicator */
 static int topbar                   = 1;        /* 0 means bottom bar */
 
 static char dmenufont[]             = "SourceCodePro-nerd:bold:size=10";
 static const char *fonts[]          = { "SourceCodePro-nerd:size=10:antialias=true:autohint=true" };
+static const unsigned int fallbackfonts    = 8;      /* fallback fonts kept loaded for glyphs missing from fonts[] */
+static const unsigned int fallbackglyphmem = 262144; /* glyph cache budget per fallback font, in bytes */
+
+/* built-in status blocks, drawn left to right when statusengine is set */
+static const StatusBlock statusblocks[] = {
+	/* reader      arg                command                          interval  sig */
+	{ NULL,        NULL,              "pamixer --get-volume-human",    0,        1 },
+	{ rdmeminfo,   NULL,              NULL,                            5,        0 },
+	{ rdloadavg,   NULL,              NULL,                            5,        0 },
+	{ rdbattery,   "BAT0",            NULL,                            30,       0 },
+	{ rdclock,     "%a %d %b %H:%M",  NULL,                            1,        0 },
+};
 
 /* default colors used if xrdb is not loaded */
 static char normbgcolor[]           = "#2e3440";
@@ -223,6 +243,9 @@ static const Key keys[] = {
 	{ MODKEY|ControlMask,				XK_d,      				setlayout,          {.v = &layouts[4]} },	/* dwindle */
 
 	{ MODKEY|ControlMask,				XK_space,  				setlayout,          {0} },
+	{ MODKEY|ControlMask,				XK_period, 				cyclelayout,        {.i = +1 } },	/* next layout, plugins included */
+	{ MODKEY|ControlMask,				XK_comma,  				cyclelayout,        {.i = -1 } },
+	{ MODKEY|ControlMask|ShiftMask,		XK_l,      				reloadlayouts,      {0} },					/* reopen layout plugins */
 	{ MODKEY,							XK_space,  				zoom,               {0} },
 	{ MODKEY|ControlMask,           	XK_space,  				focusmaster,        {0} },
 
@@ -31,15 +31,26 @@ endif
 #FREETYPEINC = ${X11INC}/freetype2
 #MANPREFIX = ${PREFIX}/man
 #KVMLIB = -lkvm
+#DLLIB =
+#RTLIB =
+
+# dlopen for layout plugins, part of libc on the BSDs and glibc 2.34+
+DLLIB = -ldl
+
+# shm_open for the state snapshot, part of libc on the BSDs and glibc 2.34+
+RTLIB = -lrt
+
+# AVX2 for the UTF-8 scanner in drw.c, x86-64 uses SSE2 otherwise (uncomment)
+#SIMDFLAGS = -mavx2
 
 # includes and libs
 INCS = -I${X11INC} -I${FREETYPEINC}
-LIBS = -L${X11LIB} -lX11 ${XINERAMALIBS} ${FREETYPELIBS} -lX11-xcb -lxcb -lxcb-res ${KVMLIB}
+LIBS = -L${X11LIB} -lX11 ${XINERAMALIBS} ${FREETYPELIBS} -lX11-xcb -lxcb -lxcb-res -lpthread ${KVMLIB} ${DLLIB} ${RTLIB}
 
 # flags
 CPPFLAGS = -D_DEFAULT_SOURCE -D_BSD_SOURCE -D_XOPEN_SOURCE=700L -DVERSION=\"${VERSION}\" ${XINERAMAFLAGS}
 #CFLAGS   = -g -std=c99 -pedantic -Wall -O0 ${INCS} ${CPPFLAGS}
-CFLAGS   = -std=c99 -pedantic -Wall -Wno-deprecated-declarations -Os ${INCS} ${CPPFLAGS}
+CFLAGS   = -std=c99 -pedantic -Wall -Wno-deprecated-declarations -Os ${SIMDFLAGS} ${INCS} ${CPPFLAGS}
 LDFLAGS  = ${LIBS}
 
 # Solaris
@@ -4,11 +4,20 @@
 #include <string.h>
 #include <X11/Xlib.h>
 #include <X11/Xft/Xft.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 #include "drw.h"
 #include "util.h"
 
 #define UTF_INVALID 0xFFFD
+#define GLYPHMEM_DEFAULT (1024 * 1024) /* Xft's own per-font glyph cache limit */
+#define NOMATCH_MIN      64
+#define NOMATCH_MAX      8192 /* slots, the set is cleared once it would outgrow this */
+#define NOGLYPH          0xFFFF
 
 /**
  * @brief Decode UTF-8 byte sequence to Unicode code point
@@ -57,6 +66,39 @@ utf8decode(const char *s_in, long *u, int *err)
 	return len;
 }
 
+/**
+ * @brief Find the run of ASCII bytes at the start of a string
+ * @param s Input string
+ * @param len Number of bytes of s that may be read
+ * @return Length of the leading run of bytes below 0x80
+ * @note Scans 32 or 16 bytes per step with AVX2 or SSE2 when the compiler
+ *       targets them, the trailing bytes are checked one at a time
+ * @note Anything that is not ASCII is left to utf8decode() to validate
+ */
+static size_t
+utf8asciirun(const char *s, size_t len)
+{
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	for (; i + 32 <= len; i += 32) {
+		unsigned int mask = _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)(s + i)));
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+#endif
+#if defined(__SSE2__)
+	for (; i + 16 <= len; i += 16) {
+		unsigned int mask = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(s + i)));
+		if (mask)
+			return i + __builtin_ctz(mask);
+	}
+#endif
+	for (; i < len && !(s[i] & 0x80); i++)
+		; /* NOP */
+	return i;
+}
+
 /**
  * @brief Create drawing context for X11 window
  * @param dpy X11 display connection
@@ -83,6 +125,7 @@ drw_create(Display *dpy, int screen, Window root, unsigned int w, unsigned int h
 	drw->drawable = XCreatePixmap(dpy, root, w, h, DefaultDepth(dpy, screen));
 	drw->gc = XCreateGC(dpy, root, 0, NULL);
 	XSetLineAttributes(dpy, drw->gc, 1, LineSolid, CapButt, JoinMiter);
+	drw->pool.max = 8;
 
 	return drw;
 }
@@ -115,6 +158,8 @@ drw_free(Drw *drw)
 	XFreePixmap(drw->dpy, drw->drawable);
 	XFreeGC(drw->dpy, drw->gc);
 	drw_fontset_free(drw->fonts);
+	drw_fontset_free(drw->pool.fonts);
+	free(drw->nomatch.cps);
 	free(drw);
 }
 
@@ -161,6 +206,24 @@ xfont_create(Drw *drw, const char *fontname, FcPattern *fontpattern)
 	return font;
 }
 
+/* Advances of the printable ASCII glyphs of a font, so ASCII runs can be
+ * measured without asking Xft for every character. */
+static void
+xfont_asciiwidths(Fnt *font)
+{
+	XGlyphInfo ext;
+	FcChar8 c;
+
+	for (c = 0; c < LENGTH(font->asciiw); c++) {
+		font->asciiw[c] = NOGLYPH;
+		if (c < ' ' || c == 0x7F || !XftCharExists(font->dpy, font->xfont, c))
+			continue;
+		XftTextExtents8(font->dpy, font->xfont, &c, 1, &ext);
+		font->asciiw[c] = MIN(MAX(ext.xOff, 0), NOGLYPH - 1);
+	}
+	font->hasascii = 1;
+}
+
 static void
 xfont_free(Fnt *font)
 {
@@ -172,6 +235,135 @@ xfont_free(Fnt *font)
 	free(font);
 }
 
+/* Fallback fonts matched at draw time live in drw->pool rather than on the
+ * configured fontset, so they can be evicted again while the configured
+ * fonts stay pinned. */
+static void
+fontpool_free(Drw *drw)
+{
+	drw_fontset_free(drw->pool.fonts);
+	drw->pool.fonts = NULL;
+	drw->pool.count = 0;
+}
+
+static void
+fontpool_evict(Drw *drw)
+{
+	Fnt **f;
+
+	/* the least recently used font is the tail */
+	while (drw->pool.count > drw->pool.max) {
+		for (f = &drw->pool.fonts; (*f)->next; f = &(*f)->next)
+			; /* NOP */
+		xfont_free(*f);
+		*f = NULL;
+		drw->pool.count--;
+		drw->pool.evictions++;
+	}
+}
+
+static void
+fontpool_add(Drw *drw, Fnt *font)
+{
+	font->isfallback = 1;
+	font->next = drw->pool.fonts;
+	drw->pool.fonts = font;
+	drw->pool.count++;
+	drw->pool.loads++;
+	fontpool_evict(drw);
+}
+
+static void
+fontpool_touch(Drw *drw, Fnt *font)
+{
+	Fnt **f;
+
+	drw->pool.hits++;
+	if (drw->pool.fonts == font)
+		return;
+	for (f = &drw->pool.fonts; *f && *f != font; f = &(*f)->next)
+		; /* NOP */
+	if (!*f)
+		return;
+	*f = font->next;
+	font->next = drw->pool.fonts;
+	drw->pool.fonts = font;
+}
+
+/* walks the configured fontset first, then the fallback pool */
+static Fnt *
+fontnext(Drw *drw, Fnt *font)
+{
+	return font->next || font->isfallback ? font->next : drw->pool.fonts;
+}
+
+static unsigned int
+nomatch_hash(unsigned int cp)
+{
+	cp = ((cp >> 16) ^ cp) * 0x21F0AAAD;
+	cp = ((cp >> 15) ^ cp) * 0xD35A2D97;
+	return (cp >> 15) ^ cp;
+}
+
+static void
+nomatch_clear(Drw *drw)
+{
+	free(drw->nomatch.cps);
+	drw->nomatch.cps = NULL;
+	drw->nomatch.size = drw->nomatch.count = 0;
+}
+
+static int
+nomatch_has(Drw *drw, long cp)
+{
+	unsigned int i, mask = drw->nomatch.size - 1;
+
+	if (drw->nomatch.count) {
+		for (i = nomatch_hash(cp) & mask; drw->nomatch.cps[i]; i = (i + 1) & mask) {
+			if (drw->nomatch.cps[i] == cp) {
+				drw->nomatch.hits++;
+				return 1;
+			}
+		}
+	}
+	drw->nomatch.misses++;
+	return 0;
+}
+
+static void
+nomatch_add(Drw *drw, long cp)
+{
+	unsigned int i, j, mask, size, *old = drw->nomatch.cps;
+
+	/* keep the load factor at or below one half */
+	if ((drw->nomatch.count + 1) * 2 > drw->nomatch.size) {
+		size = drw->nomatch.size ? drw->nomatch.size * 2 : NOMATCH_MIN;
+		if (size > NOMATCH_MAX) {
+			nomatch_clear(drw);
+			drw->nomatch.resets++;
+			old = NULL;
+			size = NOMATCH_MIN;
+		}
+		drw->nomatch.cps = ecalloc(size, sizeof(unsigned int));
+		mask = size - 1;
+		for (j = 0; old && j < drw->nomatch.size; j++) {
+			if (!old[j])
+				continue;
+			for (i = nomatch_hash(old[j]) & mask; drw->nomatch.cps[i]; i = (i + 1) & mask)
+				; /* NOP */
+			drw->nomatch.cps[i] = old[j];
+		}
+		free(old);
+		drw->nomatch.size = size;
+	}
+	mask = drw->nomatch.size - 1;
+	for (i = nomatch_hash(cp) & mask; drw->nomatch.cps[i]; i = (i + 1) & mask)
+		if (drw->nomatch.cps[i] == cp)
+			return;
+	drw->nomatch.cps[i] = cp;
+	drw->nomatch.count++;
+}
+
 Fnt*
 drw_fontset_create(Drw* drw, const char *fonts[], size_t fontcount)
 {
@@ -181,6 +373,10 @@ drw_fontset_create(Drw* drw, const char *fonts[], size_t fontcount)
 	if (!drw || !fonts)
 		return NULL;
 
+	/* fallbacks and misses were matched against the old primary font */
+	fontpool_free(drw);
+	nomatch_clear(drw);
+
 	for (i = 1; i <= fontcount; i++) {
 		if ((cur = xfont_create(drw, fonts[fontcount - i], NULL))) {
 			cur->next = ret;
@@ -199,6 +395,33 @@ drw_fontset_free(Fnt *font)
 	}
 }
 
+void
+drw_fontset_setfallback(Drw *drw, unsigned int max, unsigned int glyphmem)
+{
+	if (!drw)
+		return;
+	/* drw_text() may hold on to one fallback font while matching another */
+	drw->pool.max = MAX(max, 2);
+	drw->pool.glyphmem = glyphmem;
+	fontpool_evict(drw);
+}
+
+void
+drw_fontset_stats(Drw *drw)
+{
+	unsigned long glyphmem;
+
+	if (!drw)
+		return;
+	glyphmem = drw->pool.glyphmem ? drw->pool.glyphmem : GLYPHMEM_DEFAULT;
+	fprintf(stderr, "drw: fallback fonts: %u/%u loaded, %lu loads, %lu evictions, %lu hits, "
+	        "glyph cache <= %lu KiB\n", drw->pool.count, drw->pool.max, drw->pool.loads,
+	        drw->pool.evictions, drw->pool.hits, drw->pool.count * glyphmem / 1024);
+	fprintf(stderr, "drw: unmatched codepoints: %u cached in %u slots, %lu hits, %lu misses, "
+	        "%lu resets\n", drw->nomatch.count, drw->nomatch.size, drw->nomatch.hits,
+	        drw->nomatch.misses, drw->nomatch.resets);
+}
+
 void
 drw_clr_create(Drw *drw, Clr *dest, const char *clrname)
 {
@@ -258,19 +481,18 @@ int
 drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert)
 {
 	int ty, ellipsis_x = 0;
-	unsigned int tmpw, ew, ellipsis_w = 0, ellipsis_len, hash, h0, h1;
+	unsigned int tmpw, ew, ellipsis_w = 0, ellipsis_len;
 	XftDraw *d = NULL;
 	Fnt *usedfont, *curfont, *nextfont;
 	int utf8strlen, utf8charlen, utf8err, render = x || y || w || h;
 	long utf8codepoint = 0;
-	const char *utf8str;
+	const char *utf8str, *end, *asciiend;
 	FcCharSet *fccharset;
 	FcPattern *fcpattern;
 	FcPattern *match;
 	XftResult result;
 	int charexists = 0, overflow = 0;
-	/* keep track of a couple codepoints for which we have no match. */
-	static unsigned int nomatches[128], ellipsis_width, invalid_width;
+	static unsigned int ellipsis_width, invalid_width;
 	static const char invalid[] = "�";
 
 	if (!drw || (render && (!drw->scheme || !w)) || !text || !drw->fonts)
@@ -291,6 +513,10 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 	}
 
 	usedfont = drw->fonts;
+	if (!usedfont->hasascii)
+		xfont_asciiwidths(usedfont);
+	end = text + strlen(text);
+	asciiend = text;
 	if (!ellipsis_width && render)
 		ellipsis_width = drw_fontset_getwidth(drw, "...");
 	if (!invalid_width && render)
@@ -300,10 +526,37 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 		utf8str = text;
 		nextfont = NULL;
 		while (*text) {
+			/* ASCII fast path: the primary font's advance table replaces
+			 * decoding, the font lookup and the extents request */
+			if (text >= asciiend)
+				asciiend = text + utf8asciirun(text, end - text);
+			if (text < asciiend && !charexists && usedfont == drw->fonts
+			&& (tmpw = usedfont->asciiw[(unsigned char)*text]) != NOGLYPH) {
+				if (ew + ellipsis_width <= w) {
+					ellipsis_x = x + ew;
+					ellipsis_w = w - ew;
+					ellipsis_len = utf8strlen;
+				}
+				if (ew + tmpw > w) {
+					overflow = 1;
+					if (!render)
+						x += tmpw;
+					else
+						utf8strlen = ellipsis_len;
+					break;
+				}
+				text++;
+				utf8strlen++;
+				ew += tmpw;
+				continue;
+			}
+
 			utf8charlen = utf8decode(text, &utf8codepoint, &utf8err);
-			for (curfont = drw->fonts; curfont; curfont = curfont->next) {
+			for (curfont = drw->fonts; curfont; curfont = fontnext(drw, curfont)) {
 				charexists = charexists || XftCharExists(drw->dpy, curfont->xfont, utf8codepoint);
 				if (charexists) {
+					if (curfont->isfallback)
+						fontpool_touch(drw, curfont);
 					drw_font_getexts(curfont, text, utf8charlen, &tmpw, NULL);
 					if (ew + ellipsis_width <= w) {
 						/* keep track where the ellipsis still fits */
@@ -341,8 +594,12 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 		if (utf8strlen) {
 			if (render) {
 				ty = y + (h - usedfont->h) / 2 + usedfont->xfont->ascent;
-				XftDrawStringUtf8(d, &drw->scheme[invert ? ColBg : ColFg],
-				                  usedfont->xfont, x, ty, (XftChar8 *)utf8str, utf8strlen);
+				if (utf8asciirun(utf8str, utf8strlen) == utf8strlen)
+					XftDrawString8(d, &drw->scheme[invert ? ColBg : ColFg],
+					               usedfont->xfont, x, ty, (XftChar8 *)utf8str, utf8strlen);
+				else
+					XftDrawStringUtf8(d, &drw->scheme[invert ? ColBg : ColFg],
+					                  usedfont->xfont, x, ty, (XftChar8 *)utf8str, utf8strlen);
 			}
 			x += ew;
 			w -= ew;
@@ -366,13 +623,8 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 			 * character must be drawn. */
 			charexists = 1;
 
-			hash = (unsigned int)utf8codepoint;
-			hash = ((hash >> 16) ^ hash) * 0x21F0AAAD;
-			hash = ((hash >> 15) ^ hash) * 0xD35A2D97;
-			h0 = ((hash >> 15) ^ hash) % LENGTH(nomatches);
-			h1 = (hash >> 17) % LENGTH(nomatches);
 			/* avoid expensive XftFontMatch call when we know we won't find a match */
-			if (nomatches[h0] == utf8codepoint || nomatches[h1] == utf8codepoint)
+			if (nomatch_has(drw, utf8codepoint))
 				goto no_match;
 
 			fccharset = FcCharSetCreate();
@@ -395,14 +647,14 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 			FcPatternDestroy(fcpattern);
 
 			if (match) {
+				if (drw->pool.glyphmem)
+					FcPatternAddInteger(match, XFT_MAX_GLYPH_MEMORY, drw->pool.glyphmem);
 				usedfont = xfont_create(drw, NULL, match);
 				if (usedfont && XftCharExists(drw->dpy, usedfont->xfont, utf8codepoint)) {
-					for (curfont = drw->fonts; curfont->next; curfont = curfont->next)
-						; /* NOP */
-					curfont->next = usedfont;
+					fontpool_add(drw, usedfont);
 				} else {
 					xfont_free(usedfont);
-					nomatches[nomatches[h0] ? h1 : h0] = utf8codepoint;
+					nomatch_add(drw, utf8codepoint);
 no_match:
 					usedfont = drw->fonts;
 				}
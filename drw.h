@@ -10,8 +10,25 @@ typedef struct Fnt {
 	XftFont *xfont;
 	FcPattern *pattern;
 	struct Fnt *next;
+	int isfallback;
+	int hasascii;                /* asciiw[] has been filled */
+	unsigned short asciiw[128];  /* advance of each ASCII glyph, or NOGLYPH */
 } Fnt;
 
+typedef struct {
+	Fnt *fonts;            /* fallback fonts, most recently used first */
+	unsigned int count;
+	unsigned int max;      /* loaded fallback fonts before evicting */
+	unsigned int glyphmem; /* client side glyph cache budget per font */
+	unsigned long hits, loads, evictions;
+} FntPool;
+
+typedef struct {
+	unsigned int *cps;     /* open addressed codepoint set, 0 is an empty slot */
+	unsigned int size, count;
+	unsigned long hits, misses, resets;
+} NoMatch;
+
 enum { ColFg, ColBg, ColBorder }; /* Clr scheme index */
 typedef XftColor Clr;
 
@@ -24,6 +41,8 @@ typedef struct {
 	GC gc;
 	Clr *scheme;
 	Fnt *fonts;
+	FntPool pool;
+	NoMatch nomatch;       /* codepoints no installed font can render */
 } Drw;
 
 /* Drawable abstraction */
@@ -37,6 +56,8 @@ void drw_fontset_free(Fnt* set);
 unsigned int drw_fontset_getwidth(Drw *drw, const char *text);
 unsigned int drw_fontset_getwidth_clamp(Drw *drw, const char *text, unsigned int n);
 void drw_font_getexts(Fnt *font, const char *text, unsigned int len, unsigned int *w, unsigned int *h);
+void drw_fontset_setfallback(Drw *drw, unsigned int max, unsigned int glyphmem);
+void drw_fontset_stats(Drw *drw);
 
 /* Colorscheme abstraction */
 void drw_clr_create(Drw *drw, Clr *dest, const char *clrname);
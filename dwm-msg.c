@@ -0,0 +1,104 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * dwm-msg sends one command to dwm's command socket and prints the reply:
+ *
+ *   dwm-msg view 3
+ *   dwm-msg setlayout 3
+ *   dwm-msg spawn st -e htop
+ *
+ * The words are joined by spaces into a single line, see ipc.c. With no
+ * arguments, commands are read from standard input one per line.
+ *
+ *   dwm-msg subscribe tags focus
+ *
+ * prints events as dwm sends them until either side goes away.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "sock.h"
+#include "util.h"
+
+static void
+usage(void)
+{
+	die("usage: dwm-msg [-s socket] [command [arg ...]]");
+}
+
+static void
+writeall(int fd, const char *buf, size_t len)
+{
+	ssize_t n;
+
+	while (len) {
+		if ((n = write(fd, buf, len)) < 0) {
+			if (errno == EINTR)
+				continue;
+			die("dwm-msg: write:");
+		}
+		buf += n;
+		len -= n;
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	char path[108], buf[4096];
+	const char *name = "dwm.sock";
+	int fd, i, status = 0;
+	ssize_t n;
+	size_t len;
+	char *p;
+
+	if (argc > 2 && !strcmp(argv[1], "-s")) {
+		name = argv[2];
+		argc -= 2;
+		argv += 2;
+	} else if (argc > 1 && argv[1][0] == '-')
+		usage();
+	if (name[0] == '/')
+		snprintf(path, sizeof(path), "%s", name);
+	else if (sock_path(path, sizeof(path), name) < 0)
+		die("dwm-msg: socket path too long");
+	if ((fd = sock_connect(path)) < 0)
+		die("dwm-msg: cannot connect to %s:", path);
+	if (argc > 1) {
+		for (i = 1; i < argc; i++) {
+			writeall(fd, argv[i], strlen(argv[i]));
+			writeall(fd, i + 1 < argc ? " " : "\n", 1);
+		}
+	} else {
+		while ((len = fread(buf, 1, sizeof(buf), stdin)))
+			writeall(fd, buf, len);
+	}
+	if (argc > 1 && !strcmp(argv[1], "subscribe"))
+		setvbuf(stdout, NULL, _IOLBF, 0); /* events, dwm closes the stream */
+	else
+		shutdown(fd, SHUT_WR);
+	/* dwm answers every line with "ok" or "error <reason>" */
+	for (len = 0; (n = read(fd, buf + len, sizeof(buf) - 1 - len)) > 0 || (n < 0 && errno == EINTR); ) {
+		if (n < 0)
+			continue;
+		len += n;
+		buf[len] = '\0';
+		while ((p = strchr(buf, '\n'))) {
+			*p = '\0';
+			if (!strncmp(buf, "error", 5)) {
+				fprintf(stderr, "dwm-msg: %s\n", buf + (buf[5] ? 6 : 5));
+				status = 1;
+			} else if (strcmp(buf, "ok"))
+				puts(buf);
+			len -= p + 1 - buf;
+			memmove(buf, p + 1, len + 1);
+		}
+		if (len == sizeof(buf) - 1)
+			len = 0; /* overlong line, dropped */
+	}
+	close(fd);
+	return status;
+}
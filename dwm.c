@@ -21,16 +21,30 @@
  * To understand everything else, start reading main().
  */
 #include <X11/XF86keysym.h>
+#include <dirent.h>
+#include <dlfcn.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <locale.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#ifdef __linux__
+#include <pthread.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+#endif /* __linux__ */
 #include <X11/cursorfont.h>
 #include <X11/keysym.h>
 #include <X11/Xatom.h>
@@ -50,6 +64,11 @@
 #endif /* __OpenBSD */
 
 #include "drw.h"
+#include "dwmstate.h"
+#include "layout.h"
+#include "match.h"
+#include "proc.h"
+#include "sock.h"
 #include "util.h"
 
 /* macros */
@@ -60,7 +79,7 @@
 #define INTERSECT(x,y,w,h,m)    (MAX(0, MIN((x)+(w),(m)->wx+(m)->ww) - MAX((x),(m)->wx)) \
                                * MAX(0, MIN((y)+(h),(m)->wy+(m)->wh) - MAX((y),(m)->wy)))
 #define ISINC(X)                ((X) > 1000 && (X) < 3000)
-#define ISVISIBLE(C)            ((C->tags & C->mon->tagset[C->mon->seltags]) || C->issticky)
+#define ISVISIBLE(C)            (((C->tags & C->mon->tagset[C->mon->seltags]) || C->issticky) && !C->swallowpending)
 #define PREVSEL                 3000
 #define MOD(N,M)                ((N)%(M) < 0 ? (N)%(M) + (M) : (N)%(M))
 #define MOUSEMASK               (BUTTONMASK|PointerMotionMask)
@@ -84,16 +103,27 @@
                                   } \
                                 }
 #define TRUNC(X,A,B)            (MAX((A), MIN((X), (B))))
+#define STATEVERSION            2 /* bump when the _DWM_STATE records change */
 
 /* enums */
 enum { CurNormal, CurResize, CurMove, CurLast }; /* cursor */
 enum { SchemeNorm, SchemeSel, SchemeStatus, SchemeTagsSel, SchemeTagsNorm, SchemeInfoSel, SchemeInfoNorm }; /* color schemes */
 enum { NetSupported, NetWMName, NetWMState, NetWMCheck,
        NetWMFullscreen, NetWMSticky, NetActiveWindow, NetWMWindowType,
-       NetWMWindowTypeDialog, NetClientList, NetLast }; /* EWMH atoms (extended window manager hints) */
+       NetWMWindowTypeDialog, NetClientList, NetClientListStacking,
+       NetCurrentDesktop, NetNumberOfDesktops, NetDesktopNames, NetWMDesktop, NetLast }; /* EWMH atoms (extended window manager hints) */
 enum { WMProtocols, WMDelete, WMState, WMTakeFocus, WMLast }; /* default atoms */
 enum { ClkTagBar, ClkLtSymbol, ClkStatusText, ClkWinTitle,
        ClkClientWin, ClkRootWin, ClkLast }; /* clicks */
+enum { PropNetName, PropName, PropTransient, PropClass, PropState,
+       PropType, PropNormalHints, PropHints, PropLast }; /* properties read by manage */
+enum { StVersion, StMons, StClients, StSelmon, StRetained, StLast }; /* _DWM_STATE header */
+enum { SmNum, SmTagset0, SmTagset1, SmSeltags, SmSellt, SmLt0, SmLt1, SmMfact,
+       SmNmaster, SmGappih, SmGappiv, SmGappoh, SmGappov, SmFlags, SmSel,
+       SmLast }; /* _DWM_STATE, per monitor */
+enum { ScWin, ScMon, ScTags, ScFlags, ScScratchkey, ScFloatbw, ScPid, ScX, ScY,
+       ScW, ScH, ScSfx, ScSfy, ScSfw, ScSfh, ScSwallowed,
+       ScLast }; /* _DWM_STATE, per client */
 
 typedef union {
 	int i; /* integer argument */
@@ -114,6 +144,7 @@ typedef struct Monitor Monitor;
 typedef struct Client Client;
 struct Client { /* a window that dwm is managing */
 	char name[256]; /* window's title as shown in bar */
+	char class[256], instance[256]; /* WM_CLASS, empty unless rules were applied */
 	float mina, maxa; /* min and max aspect ratios when resizing windows */
 	int x, y, w, h; /* current pos of window */
 	int sfx, sfy, sfw, sfh; /* stored float geometry, used on mode revert */
@@ -122,10 +153,15 @@ struct Client { /* a window that dwm is managing */
 	int bw, oldbw; /* current and prev border widths */
 	unsigned int tags; /* bitmasks for which tags window is visible on */
 	int isfixed, isfloating, isurgent, neverfocus, oldstate, isfullscreen, issticky, isterminal, noswallow; /* window states */
+	int desktop; /* _NET_WM_DESKTOP as last published, see updatedesktops() */
+	int grabbed; /* button grabs on win: 0 none, 1 unfocused, 2 focused, see grabbuttons() */
 	char scratchkey;
 	int floatborderpx;
 	int hasfloatbw;
 	pid_t pid; /* pid of application in window - useful for swallowing */
+	int swallowpending; /* unmapped and out of the layout until swallow is decided */
+	unsigned long pidseq; /* pid query resolving this client */
+	unsigned long long swallowdue; /* ms, when a pending client is shown anyway */
 	Client *next; /* next client, in the linked list of all clients */
 	Client *snext; /* next in the STACK */
 	Client *swallowing; /* points to the client this one is swallowing (swallow patch) */
@@ -140,6 +176,11 @@ typedef struct { /* key press interactions */
 	const Arg arg;
 } Key;
 
+typedef struct { /* keyboard mapping entry, code 0 marks a free slot */
+	KeySym sym;
+	KeyCode code;
+} SymCode;
+
 typedef struct { /* layouts */
 	const char *symbol;
 	void (*arrange)(Monitor *);
@@ -174,6 +215,8 @@ struct Monitor {
 	Monitor *next;
 	Window barwin;
 	const Layout *lt[2];
+	int arrangedue; /* while arrange is held: 1 lay out, 2 restack as well */
+	int bardue;     /* while arrange is held: the bar needs drawing */
 };
 
 typedef struct {
@@ -197,8 +240,47 @@ typedef struct {
 	const Arg arg2;
 } TwoFuncPtr;
 
+typedef struct { /* descriptor multiplexed into the event loop */
+	int fd;
+	short events;
+	void (*func)(int fd, short revents);
+} Watch;
+
+typedef struct Job Job;
+struct Job { /* shell command whose output is collected asynchronously */
+	pid_t pid;
+	int fd;                   /* read end of the command's stdout */
+	char out[1024];           /* output, truncated to fit */
+	size_t len;
+	int id;                   /* caller's tag, passed back through done */
+	void (*done)(Job *j);     /* called once the command closed stdout */
+	Job *next;
+};
+
+#ifdef __linux__
+typedef struct { /* pid and ancestry of a new window, resolved by pidworker */
+	Window win;
+	unsigned long seq;
+	int needchain;            /* resolve ancestors, the window may be swallowed */
+	pid_t pid;
+	int n;
+	pid_t chain[64];          /* pid, parent, grandparent, ... */
+} PidQuery;
+#endif /* __linux__ */
+
+typedef struct { /* built-in status block */
+	int (*reader)(const char *arg, char *buf, size_t size); /* in-process source */
+	const char *arg;          /* reader argument */
+	const char *command;      /* shell command, its first output line is shown */
+	unsigned int interval;    /* seconds between updates, 0 for start and clicks only */
+	unsigned int sig;         /* click id, 0 to ignore clicks */
+} StatusBlock;
+
 /* function declarations */
+static void applyrule(Client *c, const Rule *r);
 static void applyrules(Client *c);
+static void buildrules(void);
+static void buildkeys(void);
 static int applysizehints(Client *c, int *x, int *y, int *w, int *h, int interact);
 static void arrange(Monitor *m);
 static void arrangemon(Monitor *m);
@@ -210,12 +292,15 @@ static void cleanup(void);
 static void cleanupmon(Monitor *mon);
 static void clientmessage(XEvent *e);
 static void configure(Client *c);
+static int configpath(char *buf, size_t size, const char *rel);
 static void configurenotify(XEvent *e);
 static void configurerequest(XEvent *e);
 static Monitor *createmon(void);
+static void cyclelayout(const Arg *arg);
 static void destroynotify(XEvent *e);
 static void detach(Client *c);
 static void detachstack(Client *c);
+static void dropretained(void);
 static Monitor *dirtomon(int dir);
 static void drawbar(Monitor *m);
 static void drawbars(void);
@@ -228,19 +313,27 @@ static void focusmon(const Arg *arg);
 static void focusstack(const Arg *arg);
 static Atom getatomprop(Client *c, Atom prop);
 static int getrootptr(int *x, int *y);
-static long getstate(Window w);
 static pid_t getstatusbarpid(void);
 static void sigstatusbar(const Arg *arg);
 static int gettextprop(Window w, Atom atom, char *text, unsigned int size);
+static Atom replyatom(xcb_get_property_reply_t *r);
+static int replyclass(xcb_get_property_reply_t *r, char **buf, const char **class, const char **instance);
+static int replysizehints(xcb_get_property_reply_t *r, XSizeHints *size);
+static int replytext(xcb_get_property_reply_t *r, char *text, unsigned int size);
+static int replywmhints(xcb_get_property_reply_t *r, XWMHints *wmh);
 static void grabbuttons(Client *c, int focused);
 static void grabkeys(void);
 static void ifroot(const Arg *arg);
 static void incnmaster(const Arg *arg);
 static void keypress(XEvent *e);
+static unsigned int keyslot(KeySym sym, unsigned int mod);
 static void killthis(Client *c);
 static void killclient(const Arg *arg);
 static void loadxrdb(void);
-static void manage(Window w, XWindowAttributes *wa);
+static void holdarrange(void);
+static void manage(Window w);
+static void managewin(Window w, XWindowAttributes *wa, xcb_get_property_reply_t **r);
+static void mapclient(Client *c);
 static void mappingnotify(XEvent *e);
 static void maprequest(XEvent *e);
 static void monocle(Monitor *m);
@@ -251,6 +344,7 @@ static void pop(Client *c);
 static void propertynotify(XEvent *e);
 static void pushstack(const Arg *arg);
 static void quit(const Arg *arg);
+static void quitdone(Job *j);
 static void quitprompt(const Arg *arg);
 static Monitor *recttomon(int x, int y, int w, int h);
 static void resize(Client *c, int x, int y, int w, int h, int interact);
@@ -258,9 +352,15 @@ static void resizeclient(Client *c, int x, int y, int w, int h);
 static void resizemouse(const Arg *arg);
 static void restack(Monitor *m);
 static void run(void);
+static void loadstate(void);
+static void restoreclient(Client *c, const long *s);
+static void restorestack(void);
+static const long *savedclient(Window w);
+static void savestate(void);
 static void scan(void);
 static int sendevent(Client *c, Atom proto);
 static void sendmon(Client *c, Monitor *m);
+static void setclientlist(Window old, Window new);
 static void setclientstate(Client *c, long state);
 static void setfocus(Client *c);
 static void setfullscreen(Client *c, int fullscreen);
@@ -270,12 +370,15 @@ static void setmfact(const Arg *arg);
 static void setup(void);
 static void seturgent(Client *c, int urg);
 static void showhide(Client *c);
+static unsigned int symslot(KeySym sym);
 static void spawn(const Arg *arg);
 static void spawnscratch(const Arg *arg);
 static void sighup(int unused);
 static void sigterm(int unused);
+static void sigusr1(int unused);
 static int stackpos(const Arg *arg);
 static void tag(const Arg *arg);
+static void titlerules(Client *c, const char *oldname);
 static void tagmon(const Arg *arg);
 static void togglebar(const Arg *arg);
 static void togglebarcolor(const Arg *arg);
@@ -292,18 +395,35 @@ static void toggletag(const Arg *arg);
 static void toggleview(const Arg *arg);
 static void unfocus(Client *c, int setfocus);
 static void unmanage(Client *c, int destroyed);
+static void unmanageall(void);
 static void unmapnotify(XEvent *e);
 static void updatebarpos(Monitor *m);
 static void updatebars(void);
 static void updateclientlist(void);
+static void updatedesktops(void);
 static int updategeom(void);
 static void updatenumlockmask(void);
+static void releasearrange(void);
+static void reloadlayouts(const Arg *arg);
+static void requestprops(Window w, xcb_get_property_cookie_t *cookies);
+static void setsizehints(Client *c, XSizeHints *size);
+static void settextprop(XTextProperty *name, char *text, unsigned int size);
+static void setwindowtype(Client *c, Atom state, Atom wtype);
+static void setwmhints(Client *c, XWMHints *wmh);
 static void updatesizehints(Client *c);
 static void updatestatus(void);
 static void updatetitle(Client *c);
 static void updatewindowtype(Client *c);
 static void updatewmhints(Client *c);
 static void view(const Arg *arg);
+static void jobread(int fd, short revents);
+static Job *runjob(const char *cmd, char *env, void (*done)(Job *j), int id);
+static int rdbattery(const char *arg, char *buf, size_t size);
+static int rdclock(const char *arg, char *buf, size_t size);
+static int rdloadavg(const char *arg, char *buf, size_t size);
+static int rdmeminfo(const char *arg, char *buf, size_t size);
+static void unwatchfd(int fd);
+static int watchfd(int fd, short events, void (*func)(int fd, short revents));
 static Client *wintoclient(Window w);
 static Monitor *wintomon(Window w);
 static int xerror(Display *dpy, XErrorEvent *ee);
@@ -312,10 +432,22 @@ static int xerrorstart(Display *dpy, XErrorEvent *ee);
 static void xrdb(const Arg *arg);
 static void zoom(const Arg *arg);
 
+#ifdef __linux__
+static void armgrace(void);
+static void graceexpired(int fd, short revents);
+static void pidcleanup(void);
+static void pidinit(void);
+static int pidquery(Client *c, int needchain);
+static void pidresolve(Client *c, const PidQuery *q);
+static void pidresults(int fd, short revents);
+static void *pidworker(void *unused);
+static Client *termforchain(const pid_t *chain, int n);
+#else
 static pid_t getparentprocess(pid_t p);
 static int isdescprocess(pid_t p, pid_t c);
-static Client *swallowingclient(Window w);
 static Client *termforwin(const Client *c);
+#endif /* __linux__ */
+static Client *swallowingclient(Window w);
 static pid_t winpid(Window w);
 
 /* variables */
@@ -330,6 +462,12 @@ static int bh;               /* bar height */
 static int lrpad;            /* sum of left and right padding for text */
 static int (*xerrorxlib)(Display *, XErrorEvent *);
 static unsigned int numlockmask = 0;
+static int *keyhead, *keynext;   /* keytab chained per keyslot(), -1 ends a chain */
+static unsigned int keymask;
+static Matcher ruleclass, ruleinstance, ruletitle; /* ruletab patterns, by field */
+static unsigned char *rulehit;   /* match_run results, four rows of nruletab */
+static SymCode *symcodes;        /* keysym -> keycodes of the current mapping */
+static unsigned int symmask;
 static void (*handler[LASTEvent]) (XEvent *) = { /* maps X event type to matching function */
 	[ButtonPress] = buttonpress, /* mouse button */
 	[ClientMessage] = clientmessage, /* messages sent from windows, like fullscreen toggle */
@@ -347,8 +485,21 @@ static void (*handler[LASTEvent]) (XEvent *) = { /* maps X event type to matchin
 	[UnmapNotify] = unmapnotify /* window needs to be unmapped */
 };
 static Atom wmatom[WMLast], netatom[NetLast];
+static Atom dwmstate;       /* root property carrying state across restarts */
+static long *saved;         /* _DWM_STATE read at startup, freed after scan() */
+static XID retained;        /* a resource of the dwm that restarted into us */
 static int restart = 1;
 static int running = 1;
+static int keymapdirty;     /* grabkeys() is due once the X queue drains */
+static Window *clientlist;  /* _NET_CLIENT_LIST, in the order windows were managed */
+static unsigned int nclientlist, clientlistsize;
+static int clientlistdirty; /* clientlist changed since it was published */
+static int stackdirty;      /* a stack changed, _NET_CLIENT_LIST_STACKING may have */
+static int desktopdirty;    /* tags may have changed, _NET_WM_DESKTOP is due */
+static int arrangeheld;     /* holdarrange() depth, arrange() only marks pending */
+static volatile sig_atomic_t dumpstats = 0;
+static Job *jobs;
+static Job *quitjob;         /* quitprompt() waiting for dmenu */
 static Cur *cursor[CurLast];
 static Clr **scheme;
 static Display *dpy;
@@ -357,9 +508,32 @@ static Monitor *mons, *selmon;
 static Window root, wmcheckwin;
 
 static xcb_connection_t *xcon;
+#ifdef __linux__
+static ProcCache proccache;      /* used by pidworker under proclock */
+static pthread_mutex_t proclock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t pidlock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pidcond = PTHREAD_COND_INITIALIZER;
+static pthread_t pidthread;
+static int pidrunning;
+static PidQuery pidq[64];        /* ring shared with pidworker under pidlock */
+static unsigned long pidhead, pidwork, pidtail; /* queued, resolved, consumed */
+static int pidstop;
+static int pidfd = -1;           /* eventfd, pidworker signals resolved queries */
+static int gracefd = -1;         /* timerfd, expires pending swallows */
+#endif /* __linux__ */
 
 /* configuration, allows nested code to access above variables */
 #include "config.h"
+#include "status.c"
+#include "plugin.c"
+#include "rc.c"
+#include "ipc.c"
+#include "state.c"
+
+/* every status and command connection and engine job at once, plus the
+ * listening sockets, rcfile, engine tick, swallow and quit prompt fds */
+static Watch watches[MAXSTATUSCONNS + MAXIPCCONNS + MAXBLOCKS + 8];
+static int nwatches;
 
 /* compile-time check if all tags fit into an unsigned int bit array. */
 struct NumTags { char limitexceeded[LENGTH(tags) > 31 ? -1 : 1]; };
@@ -367,7 +541,8 @@ struct NumTags { char limitexceeded[LENGTH(tags) > 31 ? -1 : 1]; };
 /* function implementations */
 /**
  * @brief Apply matching rules to a new client window
- * @param c Pointer to the client structure to apply rules to
+ * @param c Pointer to the client structure to apply rules to, with its
+ *        class and instance filled in ("broken" if unset)
  * 
  * This function applies configuration rules to newly created windows based on their
  * class, instance, and title properties. Rules are defined in config.h and control
@@ -375,19 +550,19 @@ struct NumTags { char limitexceeded[LENGTH(tags) > 31 ? -1 : 1]; };
  * terminal/swallowing behavior.
  * 
  * The function iterates through all rules and applies the first matching rule or
- * multiple matching rules (rules can accumulate effects). Window properties are
- * extracted using XGetClassHint() and matched against rule criteria using strstr().
+ * multiple matching rules (rules can accumulate effects). The class and instance
+ * come from the WM_CLASS reply fetched by manage(). Each field is searched for
+ * all rule patterns at once by the matchers buildrules() compiled, which finds
+ * the same substrings strstr() would.
  * 
  * @note Rules can set: terminal status, floating state, tags, scratchpad key,
  *       floating border width, geometry, and target monitor
  * @note If no tags are set after rule application, defaults to current monitor tagset
  * 
  * @warning SECURITY ISSUE: No input sanitization on class/instance strings before
- *          strstr() matching could lead to unexpected matches
+ *          substring matching could lead to unexpected matches
  * @warning BOUNDS CHECKING: No validation that r->floatx/y/w/h values are within
  *          screen bounds, could place windows outside visible area
- * @warning MEMORY LEAK: If XGetClassHint fails, ch.res_class/res_name may not be
- *          properly freed in all error paths
  * @warning DUPLICATE RULES: No protection against multiple rules applying conflicting
  *          settings to the same client
  * @warning INVALID VALUES: No validation of scratchkey character range or validity
@@ -402,54 +577,59 @@ struct NumTags { char limitexceeded[LENGTH(tags) > 31 ? -1 : 1]; };
 void
 applyrules(Client *c)
 {
-	const char *class, *instance;
 	unsigned int i;
 	const Rule *r;
-	Monitor *m;
-	XClassHint ch = { NULL, NULL };
+	unsigned char *hclass = rulehit, *hinstance = hclass + nruletab, *htitle = hinstance + nruletab;
 
 	/* rule matching */
 	c->isfloating = 0;
 	c->tags = 0;
-
-	XGetClassHint(dpy, c->win, &ch);
-	class    = ch.res_class ? ch.res_class : broken;
-	instance = ch.res_name  ? ch.res_name  : broken;
 	c->scratchkey = 0;
-	for (i = 0; i < LENGTH(rules); i++) {
-		r = &rules[i];
-		if ((!r->title || strstr(c->name, r->title))
-		&& (!r->class || strstr(class, r->class))
-		&& (!r->instance || strstr(instance, r->instance)))
-		{
-			c->isterminal = r->isterminal;
-			c->noswallow  = r->noswallow;
-			c->isfloating = r->isfloating;
-			c->tags |= r->tags;
-			c->scratchkey = r->scratchkey;
-			if (r->floatborderpx >= 0) {
-				c->floatborderpx = r->floatborderpx;
-				c->hasfloatbw = 1;
-			}
-			if (r->isfloating) {
-				if (r->floatx >= 0) c->x = c->mon->mx + r->floatx;
-				if (r->floaty >= 0) c->y = c->mon->my + r->floaty;
-				if (r->floatw >= 0) c->w = r->floatw;
-				if (r->floath >= 0) c->h = r->floath;
-			}
-			for (m = mons; m && m->num != r->monitor; m = m->next);
-			if (m)
-				c->mon = m;
-		}
+	memset(rulehit, 0, 3 * nruletab);
+	match_run(&ruleclass, c->class, hclass);
+	match_run(&ruleinstance, c->instance, hinstance);
+	match_run(&ruletitle, c->name, htitle);
+	for (i = 0; i < nruletab; i++) {
+		r = &ruletab[i];
+		if ((!r->title || htitle[i])
+		&& (!r->class || hclass[i])
+		&& (!r->instance || hinstance[i]))
+			applyrule(c, r);
 	}
-	if (ch.res_class)
-		XFree(ch.res_class);
-	if (ch.res_name)
-		XFree(ch.res_name);
 
 	c->tags = c->tags & TAGMASK ? c->tags & TAGMASK : c->mon->tagset[c->mon->seltags];
 }
 
+/**
+ * @brief Apply one matching rule on top of what earlier rules set
+ * @param c Client the rule matched
+ * @param r Rule to apply; its tags are added to c->tags
+ */
+void
+applyrule(Client *c, const Rule *r)
+{
+	Monitor *m;
+
+	c->isterminal = r->isterminal;
+	c->noswallow  = r->noswallow;
+	c->isfloating = r->isfloating;
+	c->tags |= r->tags;
+	c->scratchkey = r->scratchkey;
+	if (r->floatborderpx >= 0) {
+		c->floatborderpx = r->floatborderpx;
+		c->hasfloatbw = 1;
+	}
+	if (r->isfloating) {
+		if (r->floatx >= 0) c->x = c->mon->mx + r->floatx;
+		if (r->floaty >= 0) c->y = c->mon->my + r->floaty;
+		if (r->floatw >= 0) c->w = r->floatw;
+		if (r->floath >= 0) c->h = r->floath;
+	}
+	for (m = mons; m && m->num != r->monitor; m = m->next);
+	if (m)
+		c->mon = m;
+}
+
 /**
  * @brief Apply size hints to client window geometry
  * @param c Pointer to client structure to apply hints to
@@ -561,6 +741,17 @@ void
 arrange(Monitor *m)
 {
 	XEvent ev; /* declares a generic X event */
+	desktopdirty = 1; /* tags only change on the way to an arrange */
+	ipcevent(EvTags, None);
+	ipcevent(EvLayout, None);
+	statedirty = 1;
+	if (arrangeheld) { /* batched, done once by releasearrange() */
+		if (m)
+			m->arrangedue = 2;
+		else for (m = mons; m; m = m->next)
+			m->arrangedue |= 1;
+		return;
+	}
 	if (m)
 		showhide(m->stack); /* show visible windows and hide others */
 	else for (m = mons; m; m = m->next)
@@ -591,6 +782,56 @@ arrangemon(Monitor *m)
 		m->lt[m->sellt]->arrange(m);
 }
 
+/**
+ * @brief Defer arrange() and drawbar() until the matching releasearrange()
+ * @note Calls nest; while held both only record on the monitor what is due
+ */
+void
+holdarrange(void)
+{
+	arrangeheld++;
+}
+
+/**
+ * @brief End a holdarrange() section
+ * @note The outermost release focuses, then lays out, restacks and draws
+ *       the bar of each monitor that asked for it, once
+ */
+void
+releasearrange(void)
+{
+	XEvent ev;
+	Monitor *m;
+	int sync = 0;
+
+	if (!arrangeheld || --arrangeheld)
+		return;
+	for (m = mons; m && !m->arrangedue; m = m->next);
+	if (m) {
+		arrangeheld++; /* focus() only marks the bars */
+		focus(NULL);
+		arrangeheld--;
+	}
+	for (m = mons; m; m = m->next) {
+		if (m->arrangedue) {
+			showhide(m->stack);
+			arrangemon(m);
+		}
+		if (m->arrangedue & 2) {
+			restack(m); /* draws the bar */
+		} else {
+			sync |= m->arrangedue;
+			if (m->bardue)
+				drawbar(m);
+		}
+		m->arrangedue = m->bardue = 0;
+	}
+	if (sync) {
+		XSync(dpy, False);
+		while (XCheckMaskEvent(dpy, EnterWindowMask, &ev));
+	}
+}
+
 /**
  * @brief Attach a client to the beginning of the monitor's client list
  * @param c Pointer to Client structure to attach
@@ -619,6 +860,7 @@ attachstack(Client *c)
 {
 	c->snext = c->mon->stack;
 	c->mon->stack = c;
+	stackdirty = 1;
 }
 
 /**
@@ -665,13 +907,17 @@ swallow(Client *p, Client *c)
 	c->mon = p->mon;
 
 	Window w = p->win;
+	int g = p->grabbed;
 	p->win = c->win;
 	c->win = w;
+	p->grabbed = c->grabbed; /* grabs stay with the windows */
+	c->grabbed = g;
+	p->desktop = -2;
 	updatetitle(p);
 	XMoveResizeWindow(dpy, p->win, p->x, p->y, p->w, p->h);
 	arrange(p->mon);
 	configure(p);
-	updateclientlist();
+	setclientlist(w, None); /* the terminal is hidden, its child stays listed */
 }
 
 /**
@@ -702,7 +948,10 @@ swallow(Client *p, Client *c)
 void
 unswallow(Client *c)
 {
+	setclientlist(c->win, c->swallowing->win);
 	c->win = c->swallowing->win;
+	c->grabbed = c->swallowing->grabbed;
+	c->desktop = -2;
 
 	free(c->swallowing);
 	c->swallowing = NULL;
@@ -718,6 +967,64 @@ unswallow(Client *c)
 	arrange(c->mon);
 }
 
+/**
+ * @brief Hash the bindings in effect by keysym and modifiers for keypress()
+ * @note Rebuilt by grabkeys(), as the cleaned modifiers depend on the
+ *       numlock modifier; chains keep the order of keytab so duplicate
+ *       bindings still all run, first one first
+ */
+void
+buildkeys(void)
+{
+	unsigned int i, n;
+	int slot;
+
+	for (n = 1; n < nkeytab * 2; n <<= 1);
+	free(keyhead);
+	free(keynext);
+	keyhead = ecalloc(n, sizeof(int));
+	keynext = ecalloc(nkeytab + 1, sizeof(int));
+	keymask = n - 1;
+	for (i = 0; i < n; i++)
+		keyhead[i] = -1;
+	for (i = nkeytab; i-- > 0; ) {
+		slot = keyslot(keytab[i].keysym, CLEANMASK(keytab[i].mod));
+		keynext[i] = keyhead[slot];
+		keyhead[slot] = i;
+	}
+}
+
+/**
+ * @brief Compile the class, instance and title patterns of the rules in effect
+ * @note One matcher per field, each pattern tagged with its rule's index;
+ *       called again when rcfile changes the rules
+ */
+void
+buildrules(void)
+{
+	unsigned int i;
+
+	match_free(&ruleclass);
+	match_free(&ruleinstance);
+	match_free(&ruletitle);
+	free(rulehit);
+	match_init(&ruleclass);
+	match_init(&ruleinstance);
+	match_init(&ruletitle);
+	rulehit = ecalloc(4 * nruletab + 1, 1);
+	for (i = 0; i < nruletab; i++) {
+		if (ruletab[i].class)
+			match_add(&ruleclass, ruletab[i].class, i);
+		if (ruletab[i].instance)
+			match_add(&ruleinstance, ruletab[i].instance, i);
+		if (ruletab[i].title)
+			match_add(&ruletitle, ruletab[i].title, i);
+	}
+	match_build(&ruleclass);
+	match_build(&ruleinstance);
+	match_build(&ruletitle);
+}
+
 /**
  * @brief Handle mouse button press events on the bar and windows
  * @param e Pointer to XEvent containing button press data
@@ -737,8 +1044,11 @@ buttonpress(XEvent *e)
 	Monitor *m;
 	XButtonPressedEvent *ev = &e->xbutton;
 	char *text, *s, ch;
+	int frozen;
 
 	click = ClkRootWin;
+	/* only the grab on an unfocused client freezes the pointer */
+	frozen = (c = wintoclient(ev->window)) && c->grabbed == 1;
 	/* focus monitor if necessary */
 	if ((m = wintomon(ev->window)) && m != selmon) {
 		unfocus(selmon->sel, 1);
@@ -762,9 +1072,13 @@ buttonpress(XEvent *e)
 			arg.ui = 1 << i;
 		} else if (ev->x < x + TEXTW(selmon->ltsymbol) && selmon->showlayout)
 			click = ClkLtSymbol;
-		else if (ev->x > selmon->ww - statusw && selmon->showstatus) {
+		else if (ev->x > selmon->ww - statusw && selmon->showstatus && nblocks) {
+			click = ClkStatusText;
+			statusblock = statusblockat(ev->x);
+		} else if (ev->x > selmon->ww - statusw && selmon->showstatus) {
 			x = selmon->ww - statusw;
 			click = ClkStatusText;
+			statusblock = -1;
 			statussig = 0; /* statuscmd stuff */
 			for (text = s = stext; *s && x <= ev->x; s++) { /* loop through to determine which block was clicked */
 				if ((unsigned char)(*s) < ' ') { /* sig delim, if block boundaries are off check this */
@@ -795,9 +1109,17 @@ buttonpress(XEvent *e)
 		} else
 			click = ClkWinTitle; 
 		if ((c = wintoclient(ev->window))) {
-		focus(c);
-		restack(selmon);
-		XAllowEvents(dpy, ReplayPointer, CurrentTime);
+		for (i = 0; i < LENGTH(buttons); i++)
+			if (buttons[i].click == ClkClientWin && buttons[i].func && buttons[i].button == ev->button
+			&& CLEANMASK(buttons[i].mask) == CLEANMASK(ev->state))
+				break;
+		if (c != selmon->sel || i < LENGTH(buttons)) {
+			focus(c);
+			restack(selmon);
+		}
+		/* a bound click stays with dwm, anything else goes on to the window */
+		if (frozen)
+			XAllowEvents(dpy, i < LENGTH(buttons) ? AsyncPointer : ReplayPointer, CurrentTime);
 		click = ClkClientWin;
 	}
 	for (i = 0; i < LENGTH(buttons); i++)
@@ -829,6 +1151,7 @@ checkotherwm(void)
  * @brief Clean up and exit dwm normally or through restart
  * @note This function is called when dwm exits normally or through restart
  * @note Switches to viewing all windows before shutdown and sets layout to NULL
+ * @note Windows are released together by unmanageall(), without relayouts
  * @note Releases all X keybindings and cleans up memory allocations
  * @note Restores keyboard focus to root window and removes EWMH properties
  * @return void
@@ -838,14 +1161,11 @@ cleanup(void)
 { /* called when dwm exits normally or thru restart */
 	Arg a = {.ui = ~0}; /* switches to viewing all windows before shutdown */
 	Layout foo = { "", NULL }; /* switches layout to NULL so no more layout logic is ran */
-	Monitor *m;
 	size_t i;
 
 	view(&a);
 	selmon->lt[selmon->sellt] = &foo;
-	for (m = mons; m; m = m->next) /* loop through every monitor */
-		while (m->stack) /* call unmanage on every client window in the stack */
-			unmanage(m->stack, 0);
+	unmanageall(); /* hand every window back in one server grab */
 	XUngrabKey(dpy, AnyKey, AnyModifier, root); /* releases all X keybindings */
 	while (mons)
 		cleanupmon(mons);
@@ -854,6 +1174,22 @@ cleanup(void)
 	for (i = 0; i < LENGTH(colors); i++)
 		free(scheme[i]);
 	free(scheme);
+	free(keyhead);
+	free(keynext);
+	free(symcodes);
+	match_free(&ruleclass);
+	match_free(&ruleinstance);
+	match_free(&ruletitle);
+	free(rulehit);
+	free(clientlist);
+	ipcquit();
+	statequit();
+	rcquit();
+	statusquit();
+	unloadplugins();
+#ifdef __linux__
+	pidcleanup();
+#endif /* __linux__ */
 	XDestroyWindow(dpy, wmcheckwin);
 	drw_free(drw);
 	XSync(dpy, False); /* flushes all X requests */
@@ -898,7 +1234,13 @@ clientmessage(XEvent *e)
 {
 	XClientMessageEvent *cme = &e->xclient;
 	Client *c = wintoclient(cme->window);
+	unsigned long d = cme->data.l[0] & 0xffffffff;
 
+	if (cme->window == root && cme->message_type == netatom[NetCurrentDesktop]) {
+		if (d < LENGTH(tags))
+			view(&(Arg){ .ui = 1 << d });
+		return;
+	}
 	if (!c)
 		return;
 	if (cme->message_type == netatom[NetWMState]) {
@@ -913,7 +1255,42 @@ clientmessage(XEvent *e)
 	} else if (cme->message_type == netatom[NetActiveWindow]) {
 		if (c != selmon->sel && !c->isurgent)
 			seturgent(c, 1);
+	} else if (cme->message_type == netatom[NetWMDesktop]) {
+		if (d == 0xffffffff)
+			c->tags = TAGMASK;
+		else if (d < LENGTH(tags))
+			c->tags = 1 << d;
+		else
+			return;
+		focus(NULL);
+		arrange(c->mon);
+	}
+}
+
+/**
+ * @brief Resolve a path under the user's configuration directory
+ * @param buf Receives the path
+ * @param size Size of buf
+ * @param rel Path relative to $XDG_CONFIG_HOME, or to ~/.config if unset
+ * @return 0, or -1 if neither is known or the path does not fit
+ */
+int
+configpath(char *buf, size_t size, const char *rel)
+{
+	const char *dir = getenv("XDG_CONFIG_HOME"), *home = getenv("HOME");
+	int n;
+
+	if (dir && *dir)
+		n = snprintf(buf, size, "%s/%s", dir, rel);
+	else if (home)
+		n = snprintf(buf, size, "%s/.config/%s", home, rel);
+	else
+		n = -1;
+	if (n < 0 || (size_t)n >= size) {
+		buf[0] = '\0';
+		return -1;
 	}
+	return 0;
 }
 
 /**
@@ -1192,6 +1569,7 @@ detachstack(Client *c)
 
 	for (tc = &c->mon->stack; *tc && *tc != c; tc = &(*tc)->snext);
 	*tc = c->snext;
+	stackdirty = 1;
 
 	if (c == c->mon->sel) {
 		for (t = c->mon->stack; t && !ISVISIBLE(t); t = t->snext);
@@ -1234,6 +1612,25 @@ dirtomon(int dir)
 	return m;
 }
 
+/**
+ * @brief Replace the bars kept by the dwm that restarted into this one
+ * @note Maps and draws the new bars, then frees every resource the old
+ *       process left behind, so the bar never shows blank
+ */
+void
+dropretained(void)
+{
+	Monitor *m;
+
+	if (!retained)
+		return;
+	for (m = mons; m; m = m->next)
+		XMapRaised(dpy, m->barwin);
+	drawbars();
+	XKillClient(dpy, retained);
+	retained = None;
+}
+
 void
 drawbar(Monitor *m) /* take a pointer to the monitor we want to draw the bar on */
 {
@@ -1243,11 +1640,18 @@ drawbar(Monitor *m) /* take a pointer to the monitor we want to draw the bar on
 	unsigned int i, occ = 0, urg = 0; /* track which tags are in use and which are urgent */
 	Client *c; /* pointer to iterate over list of windows on this monitor */
 
+	if (arrangeheld) { /* drawn once by releasearrange() */
+		m->bardue = 1;
+		return;
+	}
 	if (!m->showbar) /* if the bar is hidden, do not draw it */
 		return;
 
 	/* draw status first so it can be overdrawn by tags later */
-	if (m == selmon && selmon->showstatus) { /* status is only drawn on selected monitor */
+	if (m == selmon && selmon->showstatus && nblocks) { /* blocks pushed over the status socket */
+		drawblocks(m);
+		tw = statusw;
+	} else if (m == selmon && selmon->showstatus) { /* status is only drawn on selected monitor */
 		char *text, *s, ch;
 		drw_setscheme(drw, scheme[SchemeStatus]); /* set the colorscheme used by the drawing context */
 		x = 0; /* keep track of horiz pos whil drawing */
@@ -1294,6 +1698,8 @@ drawbar(Monitor *m) /* take a pointer to the monitor we want to draw the bar on
 		drw_setscheme(drw, scheme[SchemeTagsNorm]);
 		x = drw_text(drw, x, 0, w, bh, lrpad / 2, m->ltsymbol, 0);
 	}
+	if (m == selmon)
+		barleftw = x;
 
 
 	if ((w = m->ww - tw - x) > bh) {
@@ -1366,8 +1772,8 @@ focus(Client *c)
 			seturgent(c, 0); /* clear urgent state */
 		detachstack(c);
 		attachstack(c); /* move c to top of the stack */
-		grabbuttons(c, 1);
 		XSetWindowBorder(dpy, c->win, scheme[SchemeSel][ColBorder].pixel);
+		grabbuttons(c, 1);
 		setfocus(c); /* inform X11 that c now has input focus */
 	} else {
 		XSetInputFocus(dpy, selmon->barwin, RevertToPointerRoot, CurrentTime);
@@ -1380,6 +1786,9 @@ focus(Client *c)
 	}else{
 		selmon->sel = c;
 	}
+	ipcevent(EvFocus, None);
+	ipcevent(EvMonitor, None);
+	statedirty = 1;
 	drawbars(); /* redraw statusbar */
 }
 
@@ -1509,29 +1918,9 @@ getrootptr(int *x, int *y)
 	return XQueryPointer(dpy, root, &dummy, &dummy, x, y, &di, &di, &dui);
 }
 
-long
-getstate(Window w)
-{
-	int format;
-	long result = -1;
-	unsigned char *p = NULL;
-	unsigned long n, extra;
-	Atom real;
-
-	if (XGetWindowProperty(dpy, w, wmatom[WMState], 0L, 2L, False, wmatom[WMState],
-		&real, &format, &n, &extra, (unsigned char **)&p) != Success)
-		return -1;
-	if (n != 0)
-		result = *p;
-	XFree(p);
-	return result;
-}
-
 int
 gettextprop(Window w, Atom atom, char *text, unsigned int size)
 {
-	char **list = NULL;
-	int n;
 	XTextProperty name;
 
 	if (!text || size == 0)
@@ -1539,63 +1928,230 @@ gettextprop(Window w, Atom atom, char *text, unsigned int size)
 	text[0] = '\0';
 	if (!XGetTextProperty(dpy, w, &name, atom) || !name.nitems)
 		return 0;
-	if (name.encoding == XA_STRING) {
-		strncpy(text, (char *)name.value, size - 1);
-	} else if (XmbTextPropertyToTextList(dpy, &name, &list, &n) >= Success && n > 0 && *list) {
+	settextprop(&name, text, size);
+	XFree(name.value);
+	return 1;
+}
+
+/* convert a NUL-terminated text property to the locale's encoding */
+void
+settextprop(XTextProperty *name, char *text, unsigned int size)
+{
+	char **list = NULL;
+	int n;
+
+	if (name->encoding == XA_STRING) {
+		strncpy(text, (char *)name->value, size - 1);
+	} else if (XmbTextPropertyToTextList(dpy, name, &list, &n) >= Success && n > 0 && *list) {
 		strncpy(text, *list, size - 1);
 		XFreeStringList(list);
 	}
 	text[size - 1] = '\0';
-	XFree(name.value);
+}
+
+/* The reply* helpers decode properties fetched with xcb_get_property the
+ * way the matching Xlib getter would, so manage() can request them all
+ * before waiting for any reply. */
+Atom
+replyatom(xcb_get_property_reply_t *r)
+{
+	if (!r || r->type != XA_ATOM || r->format != 32 || xcb_get_property_value_length(r) < 4)
+		return None;
+	return *(xcb_atom_t *)xcb_get_property_value(r);
+}
+
+/* WM_CLASS is "instance\0class\0"; *buf must be freed by the caller */
+int
+replyclass(xcb_get_property_reply_t *r, char **buf, const char **class, const char **instance)
+{
+	int len;
+
+	*buf = NULL;
+	if (!r || r->type != XA_STRING || r->format != 8 || !(len = xcb_get_property_value_length(r)))
+		return 0;
+	*buf = ecalloc(len + 1, 1);
+	memcpy(*buf, xcb_get_property_value(r), len);
+	*instance = *buf;
+	if ((int)strlen(*buf) + 1 < len)
+		*class = *buf + strlen(*buf) + 1;
+	return 1;
+}
+
+int
+replysizehints(xcb_get_property_reply_t *r, XSizeHints *size)
+{
+	int32_t *v;
+	int n;
+
+	/* 15 fields predate ICCCM 1.0, which added base size and gravity */
+	if (!r || r->type != XA_WM_SIZE_HINTS || r->format != 32
+	|| (n = xcb_get_property_value_length(r) / 4) < 15)
+		return 0;
+	v = xcb_get_property_value(r);
+	size->flags = (uint32_t)v[0];
+	size->x = v[1];
+	size->y = v[2];
+	size->width = v[3];
+	size->height = v[4];
+	size->min_width = v[5];
+	size->min_height = v[6];
+	size->max_width = v[7];
+	size->max_height = v[8];
+	size->width_inc = v[9];
+	size->height_inc = v[10];
+	size->min_aspect.x = v[11];
+	size->min_aspect.y = v[12];
+	size->max_aspect.x = v[13];
+	size->max_aspect.y = v[14];
+	if (n >= 18) {
+		size->base_width = v[15];
+		size->base_height = v[16];
+		size->win_gravity = v[17];
+	} else
+		size->flags &= ~(PBaseSize|PWinGravity);
 	return 1;
 }
 
+int
+replytext(xcb_get_property_reply_t *r, char *text, unsigned int size)
+{
+	XTextProperty name;
+	int len;
+
+	text[0] = '\0';
+	if (!r || !r->format || !(len = xcb_get_property_value_length(r)))
+		return 0;
+	/* unlike XGetTextProperty, xcb does not terminate the value */
+	name.value = ecalloc(len + 1, 1);
+	memcpy(name.value, xcb_get_property_value(r), len);
+	name.encoding = r->type;
+	name.format = r->format;
+	name.nitems = len / (r->format / 8);
+	settextprop(&name, text, size);
+	free(name.value);
+	return 1;
+}
+
+int
+replywmhints(xcb_get_property_reply_t *r, XWMHints *wmh)
+{
+	int32_t *v;
+	int n;
+
+	/* window_group was added last and may be missing */
+	if (!r || r->type != XA_WM_HINTS || r->format != 32
+	|| (n = xcb_get_property_value_length(r) / 4) < 8)
+		return 0;
+	v = xcb_get_property_value(r);
+	wmh->flags = v[0];
+	wmh->input = v[1];
+	wmh->initial_state = v[2];
+	wmh->icon_pixmap = (uint32_t)v[3];
+	wmh->icon_window = (uint32_t)v[4];
+	wmh->icon_x = v[5];
+	wmh->icon_y = v[6];
+	wmh->icon_mask = (uint32_t)v[7];
+	wmh->window_group = n > 8 ? (uint32_t)v[8] : 0;
+	if (n <= 8)
+		wmh->flags &= ~WindowGroupHint;
+	return 1;
+}
+
+/**
+ * @brief Grab the buttons of a client window for its focus state
+ * @param c Client whose window to grab on
+ * @param focused 1 for the focused client, 0 otherwise
+ * @note An unfocused window gets one AnyButton grab that freezes the pointer
+ *       until buttonpress() focuses it and replays the click; the focused
+ *       window only gets async grabs of the ClkClientWin bindings, so its
+ *       clicks are never held up by dwm. Requests are only sent when the
+ *       state changes, numlockmask is the one grabkeys() last read
+ */
 void
 grabbuttons(Client *c, int focused)
 {
-	updatenumlockmask();
-	{
-		unsigned int i, j;
-		unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
-		XUngrabButton(dpy, AnyButton, AnyModifier, c->win);
-		if (!focused)
-			XGrabButton(dpy, AnyButton, AnyModifier, c->win, False,
-				BUTTONMASK, GrabModeSync, GrabModeSync, None, None);
-		for (i = 0; i < LENGTH(buttons); i++)
-			if (buttons[i].click == ClkClientWin)
-				for (j = 0; j < LENGTH(modifiers); j++)
-					XGrabButton(dpy, buttons[i].button,
-						buttons[i].mask | modifiers[j],
-						c->win, False, BUTTONMASK,
-						GrabModeAsync, GrabModeSync, None, None);
+	unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
+	unsigned int i, j;
+
+	if (c->grabbed == 1 + focused)
+		return;
+	c->grabbed = 1 + focused;
+	XUngrabButton(dpy, AnyButton, AnyModifier, c->win);
+	if (!focused) {
+		XGrabButton(dpy, AnyButton, AnyModifier, c->win, False,
+			BUTTONMASK, GrabModeSync, GrabModeAsync, None, None);
+		return;
 	}
+	for (i = 0; i < LENGTH(buttons); i++)
+		if (buttons[i].click == ClkClientWin)
+			for (j = 0; j < LENGTH(modifiers); j++)
+				XGrabButton(dpy, buttons[i].button, buttons[i].mask | modifiers[j],
+					c->win, False, BUTTONMASK, GrabModeAsync, GrabModeAsync, None, None);
 }
 
+/**
+ * @brief Grab the keys of every binding, changing only what differs from
+ *        the grabs already held
+ * @note A mapping change usually moves a handful of keycodes; ungrabbing
+ *       everything would drop all bindings for a moment and regrab
+ *       hundreds of keycodes
+ */
 void
 grabkeys(void)
 {
+	static unsigned char grabbed[256][32]; /* keycode x modifier mask bits */
+	unsigned int oldnumlock = numlockmask;
+
 	updatenumlockmask();
+	if (numlockmask != oldnumlock && selmon && selmon->sel) {
+		selmon->sel->grabbed = 0; /* its bindings were grabbed with the old mask */
+		grabbuttons(selmon->sel, 1);
+	}
 	{
-		unsigned int i, j, k;
+		unsigned char want[256][32];
+		unsigned int i, j, k, n, mod;
 		unsigned int modifiers[] = { 0, LockMask, numlockmask, numlockmask|LockMask };
 		int start, end, skip;
 		KeySym *syms;
 
-		XUngrabKey(dpy, AnyKey, AnyModifier, root);
+		buildkeys(); /* CLEANMASK depends on numlockmask */
 		XDisplayKeycodes(dpy, &start, &end);
 		syms = XGetKeyboardMapping(dpy, start, end - start + 1, &skip);
 		if (!syms)
 			return;
-		for (k = start; k <= end; k++)
-			for (i = 0; i < LENGTH(keys); i++)
-				/* skip modifier codes, we do that ourselves */
-				if (keys[i].keysym == syms[(k - start) * skip])
-					for (j = 0; j < LENGTH(modifiers); j++)
-						XGrabKey(dpy, k,
-							 keys[i].mod | modifiers[j],
-							 root, True,
-							 GrabModeAsync, GrabModeAsync);
+		/* index the mapping by keysym once, instead of comparing every
+		 * keycode against every binding */
+		for (n = 1; n < (unsigned int)(end - start + 1) * 2; n <<= 1);
+		free(symcodes);
+		symcodes = ecalloc(n, sizeof(SymCode));
+		symmask = n - 1;
+		for (k = start; k <= end; k++) {
+			/* skip modifier codes, we do that ourselves */
+			if (syms[(k - start) * skip] == NoSymbol)
+				continue;
+			for (j = symslot(syms[(k - start) * skip]); symcodes[j].code; j = (j + 1) & symmask);
+			symcodes[j].sym = syms[(k - start) * skip];
+			symcodes[j].code = k;
+		}
 		XFree(syms);
+		memset(want, 0, sizeof(want));
+		for (i = 0; i < nkeytab; i++)
+			for (k = symslot(keytab[i].keysym); symcodes[k].code; k = (k + 1) & symmask)
+				if (symcodes[k].sym == keytab[i].keysym)
+					for (j = 0; j < LENGTH(modifiers); j++) {
+						mod = (keytab[i].mod | modifiers[j]) & 0xff;
+						want[symcodes[k].code][mod >> 3] |= 1 << (mod & 7);
+					}
+		for (k = 0; k < 256; k++)
+			for (mod = 0; mod < 256; mod++) {
+				i = mod >> 3;
+				j = 1 << (mod & 7);
+				if ((grabbed[k][i] & j) && !(want[k][i] & j))
+					XUngrabKey(dpy, k, mod, root);
+				else if (!(grabbed[k][i] & j) && (want[k][i] & j))
+					XGrabKey(dpy, k, mod, root, True, GrabModeAsync, GrabModeAsync);
+			}
+		memcpy(grabbed, want, sizeof(grabbed));
 	}
 }
 
@@ -1630,20 +2186,36 @@ isuniquegeom(XineramaScreenInfo *unique, size_t n, XineramaScreenInfo *info)
 }
 #endif /* XINERAMA */
 
+/**
+ * @brief Hash slot of a key binding in keyhead
+ * @param sym Keysym of the binding or press
+ * @param mod Modifiers, already passed through CLEANMASK
+ * @return Index into keyhead
+ */
+unsigned int
+keyslot(KeySym sym, unsigned int mod)
+{
+	unsigned int h = ((unsigned int)sym ^ mod << 24) * 2654435761u;
+
+	return (h ^ h >> 16) & keymask;
+}
+
 void
 keypress(XEvent *e) /* receives a keyboard press XEvent from X11 */
 {
-	unsigned int i; /* will loop over keybinds */
+	int i; /* will walk the binds sharing a slot */
+	unsigned int mod; /* modifiers without lock keys */
 	KeySym keysym; /* symbolic name, like XK_b or XK_space */
 	XKeyEvent *ev; /* pointer to the key event data */
 
 	ev = &e->xkey; /* grabs the XKeyEvent from XEvent */
 	keysym = XKeycodeToKeysym(dpy, (KeyCode)ev->keycode, 0); /* translates raw keycode into symbolic keysym */
-	for (i = 0; i < LENGTH(keys); i++) /* loop thru all binds in keys[] (config.h) */
-		if (keysym == keys[i].keysym
-		&& CLEANMASK(keys[i].mod) == CLEANMASK(ev->state)
-		&& keys[i].func) /* check that a pointer function exists */
-			keys[i].func(&(keys[i].arg)); /* if the pressed key matches a bind, call the function associated w/ that bind */
+	mod = CLEANMASK(ev->state);
+	for (i = keyhead[keyslot(keysym, mod)]; i >= 0; i = keynext[i]) /* binds in keytab (config.h and rcfile) hashed like this press */
+		if (keysym == keytab[i].keysym
+		&& CLEANMASK(keytab[i].mod) == mod
+		&& keytab[i].func) /* check that a pointer function exists */
+			keytab[i].func(&(keytab[i].arg)); /* if the pressed key matches a bind, call the function associated w/ that bind */
 }
 
 void
@@ -1679,29 +2251,35 @@ killclient(const Arg *arg)
     }
 }
 
+/**
+ * @brief Ask through dmenu whether to quit, restart or carry on
+ * @param arg Unused
+ * @note The answer is collected by runjob(), dwm keeps handling events
+ *       while dmenu is open; a second request while it is open is ignored
+ */
 void
 quitprompt(const Arg *arg)
 {
-	FILE *pp = popen("echo -e \"no\nrestart\nyes\" | dmenu -i -sb red -p \"Quit DWM?\"", "r");
-	if(pp != NULL) {
-		char buf[1024];
-		if (fgets(buf, sizeof(buf), pp) == NULL) {
-			fprintf(stderr, "Quitprompt: Error reading pipe!\n");
-			return;
-		}
-		if (strcmp(buf, "yes\n") == 0) {
-			pclose(pp);
-			restart = 0;
-			quit(NULL);
-		} else if (strcmp(buf, "restart\n") == 0) {
-			pclose(pp);
-			restart = 1;
-			quit(NULL);
-		} else if (strcmp(buf, "no\n") == 0) {
-			pclose(pp);
-			return;
-		}
-	}
+	if (!quitjob)
+		quitjob = runjob("printf 'no\\nrestart\\nyes\\n' | dmenu -i -sb red -p 'Quit DWM?'",
+			NULL, quitdone, 0);
+}
+
+/**
+ * @brief Act on the answer to quitprompt()
+ * @param j Finished prompt, its output is the chosen line
+ */
+void
+quitdone(Job *j)
+{
+	quitjob = NULL;
+	if (!strcmp(j->out, "yes\n"))
+		restart = 0;
+	else if (!strcmp(j->out, "restart\n"))
+		restart = 1;
+	else
+		return; /* no, or dmenu dismissed */
+	running = 0;
 }
 
 void
@@ -1735,10 +2313,29 @@ loadxrdb(void)
   XCloseDisplay(display);
 }
 
+/* send the property requests managewin() reads, without waiting for replies */
+void
+requestprops(Window w, xcb_get_property_cookie_t *cookies)
+{
+	const Atom props[PropLast][2] = { /* property, type */
+		[PropNetName]     = { netatom[NetWMName], AnyPropertyType },
+		[PropName]        = { XA_WM_NAME, AnyPropertyType },
+		[PropTransient]   = { XA_WM_TRANSIENT_FOR, XA_WINDOW },
+		[PropClass]       = { XA_WM_CLASS, XA_STRING },
+		[PropState]       = { netatom[NetWMState], XA_ATOM },
+		[PropType]        = { netatom[NetWMWindowType], XA_ATOM },
+		[PropNormalHints] = { XA_WM_NORMAL_HINTS, XA_WM_SIZE_HINTS },
+		[PropHints]       = { XA_WM_HINTS, XA_WM_HINTS },
+	};
+	int i;
+
+	for (i = 0; i < PropLast; i++)
+		cookies[i] = xcb_get_property(xcon, 0, w, props[i][0], props[i][1], 0, 1024);
+}
+
 /**
  * @brief Manage a new window and integrate it into the window management system
  * @param w Window ID of the new window to manage
- * @param wa Pointer to XWindowAttributes containing initial window properties
  * 
  * This function is called when a new window requests to be mapped. It creates a Client
  * structure to represent the window, applies configuration rules, handles window swallowing,
@@ -1754,6 +2351,9 @@ loadxrdb(void)
  * 7. Sets up event masks and window properties
  * 8. Maps the window and potentially performs swallowing
  * 
+ * The attributes, geometry and every property managing needs are requested
+ * together and the replies read afterwards, one round trip per window.
+ * 
  * @note This is the primary entry point for all new windows in DWM
  * @note Window swallowing allows terminals to "swallow" their child processes
  * @note Transient windows inherit properties from their parent window
@@ -1770,15 +2370,61 @@ loadxrdb(void)
  * @return void
  */
 void
-manage(Window w, XWindowAttributes *wa)
+manage(Window w)
 { /* after a window is passed from maprequest, manage determines how to treat it and add it to the stack */
+	xcb_get_window_attributes_cookie_t acook;
+	xcb_get_geometry_cookie_t gcook;
+	xcb_get_property_cookie_t cookies[PropLast];
+	xcb_get_window_attributes_reply_t *attr;
+	xcb_get_geometry_reply_t *geom;
+	xcb_get_property_reply_t *r[PropLast];
+	XWindowAttributes wa;
+	int i;
+
+	/* send every request for the window before reading any reply, so
+	 * managing costs one round trip instead of one per property; the
+	 * properties of an override-redirect window are read and dropped */
+	acook = xcb_get_window_attributes(xcon, w);
+	gcook = xcb_get_geometry(xcon, w);
+	requestprops(w, cookies);
+	attr = xcb_get_window_attributes_reply(xcon, acook, NULL);
+	geom = xcb_get_geometry_reply(xcon, gcook, NULL);
+	for (i = 0; i < PropLast; i++)
+		r[i] = xcb_get_property_reply(xcon, cookies[i], NULL);
+	if (attr && geom && !attr->override_redirect) {
+		wa.x = geom->x;
+		wa.y = geom->y;
+		wa.width = geom->width;
+		wa.height = geom->height;
+		wa.border_width = geom->border_width;
+		wa.map_state = attr->map_state;
+		managewin(w, &wa, r);
+	}
+	free(attr);
+	free(geom);
+	for (i = 0; i < PropLast; i++)
+		free(r[i]);
+}
+
+/* manage w from property replies fetched by requestprops */
+void
+managewin(Window w, XWindowAttributes *wa, xcb_get_property_reply_t **r)
+{
+	const char *class = broken, *instance = broken;
+	char *classbuf;
+	XSizeHints size;
+	XWMHints wmh;
 	Client *c, *t = NULL, *term = NULL;
 	Window trans = None;
 	XWindowChanges wc;
+	const long *s = NULL;
 
 	c = ecalloc(1, sizeof(Client)); /* allocate and initialize a new Client struct to represent the window */
 	c->win = w;
+	c->desktop = -2;
+#ifndef __linux__
 	c->pid = winpid(w); /* pid used for things like swallowing */
+#endif /* __linux__ */
 	/* geometry using XWindowAttributes */
 	c->x = c->oldx = wa->x;
 	c->y = c->oldy = wa->y;
@@ -1786,14 +2432,30 @@ manage(Window w, XWindowAttributes *wa)
 	c->h = c->oldh = wa->height;
 	c->oldbw = wa->border_width;
 
-	updatetitle(c); /* grabs title */
-	if (XGetTransientForHint(dpy, w, &trans) && (t = wintoclient(trans))) { /* if transient, it inherits tags+mon of parent */
+	/* grabs title */
+	if (!replytext(r[PropNetName], c->name, sizeof c->name))
+		replytext(r[PropName], c->name, sizeof c->name);
+	if (c->name[0] == '\0') /* hack to mark broken clients */
+		strcpy(c->name, broken);
+	if (r[PropTransient] && r[PropTransient]->type == XA_WINDOW && xcb_get_property_value_length(r[PropTransient]) >= 4)
+		trans = *(xcb_window_t *)xcb_get_property_value(r[PropTransient]);
+	if (trans && (t = wintoclient(trans))) { /* if transient, it inherits tags+mon of parent */
 		c->mon = t->mon;
 		c->tags = t->tags;
 	} else {
 		c->mon = selmon; /* assigns to selected monitor */
-		term = termforwin(c); /* tries to find a terminal for swallowing */
-		applyrules(c); /* apply any matching tag rules from config.h */
+		replyclass(r[PropClass], &classbuf, &class, &instance);
+		snprintf(c->class, sizeof c->class, "%s", class);
+		snprintf(c->instance, sizeof c->instance, "%s", instance);
+		free(classbuf);
+		if ((s = savedclient(w))) { /* restarted, rules were applied before */
+			restoreclient(c, s);
+		} else {
+#ifndef __linux__
+			term = termforwin(c); /* tries to find a terminal for swallowing */
+#endif /* __linux__ */
+			applyrules(c); /* apply any matching tag rules from config.h */
+		}
 	}
 		/* ensure window fits to visible bounds of monitor */
 	if (c->x + WIDTH(c) > c->mon->wx + c->mon->ww)
@@ -1808,15 +2470,28 @@ manage(Window w, XWindowAttributes *wa)
 	XConfigureWindow(dpy, w, CWBorderWidth, &wc);
 	XSetWindowBorder(dpy, w, scheme[SchemeNorm][ColBorder].pixel);
 	configure(c); /* propagates border_width, if size doesn't change */
-	updatewindowtype(c);
-	updatesizehints(c);
-	updatewmhints(c);
+	setwindowtype(c, replyatom(r[PropState]), replyatom(r[PropType]));
+	if (!replysizehints(r[PropNormalHints], &size))
+		size.flags = PSize;
+	setsizehints(c, &size);
+	if (replywmhints(r[PropHints], &wmh))
+		setwmhints(c, &wmh);
 	c->sfx = c->x;
 	c->sfy = c->y;
 	c->sfw = c->w;
 	c->sfh = c->h;
 	c->x = c->mon->mx + (c->mon->mw - WIDTH(c)) / 2;
 	c->y = c->mon->my + (c->mon->mh - HEIGHT(c)) / 2;
+	if (s) {
+		c->x = s[ScX];
+		c->y = s[ScY];
+		c->w = s[ScW];
+		c->h = s[ScH];
+		c->sfx = s[ScSfx];
+		c->sfy = s[ScSfy];
+		c->sfw = s[ScSfw];
+		c->sfh = s[ScSfh];
+	}
 	XSelectInput(dpy, w, EnterWindowMask|FocusChangeMask|PropertyChangeMask|StructureNotifyMask);
 	grabbuttons(c, 0);
 	if (!c->isfloating)
@@ -1825,10 +2500,33 @@ manage(Window w, XWindowAttributes *wa)
 		XRaiseWindow(dpy, c->win);
 	attach(c); /* add to the monitor's client list */
 	attachstack(c); /* add it to the stack */
-	XChangeProperty(dpy, root, netatom[NetClientList], XA_WINDOW, 32, PropModeAppend, /* add to X11 client list */
-		(unsigned char *) &(c->win), 1);
+	setclientlist(None, c->win); /* add to the EWMH client list */
 	XMoveResizeWindow(dpy, c->win, c->x + 2 * sw, c->y, c->w, c->h); /* some windows require this */
 	setclientstate(c, NormalState);
+#ifdef __linux__
+	/* pidworker looks up the pid and a terminal to swallow; a candidate
+	 * stays unmapped and out of the layout until the answer arrives or
+	 * swallowgrace runs out, so a swallow does not relayout twice; windows
+	 * managed in a batch by scan() are already on screen; restored ones
+	 * keep their pid and are not swallowed again */
+	if (!c->pid && pidquery(c, !s && !t && !c->isterminal && !c->noswallow) == 0
+	&& !s && !t && !c->isterminal && !c->noswallow && swallowgrace && !arrangeheld) {
+		c->swallowpending = 1;
+		armgrace();
+		return;
+	}
+#endif /* __linux__ */
+	mapclient(c);
+	if (term)
+		swallow(term, c); /* if new window is child of a terminal, replace terminal (swallow) */
+	if (!arrangeheld)
+		focus(NULL); /* focus the client */
+}
+
+/* map a newly managed client and lay it out as the selected one */
+void
+mapclient(Client *c)
+{
 	if(selmon->sel && selmon->sel->isfullscreen && !c->isfloating) /* if a fullscreen window was focused, toggle fullscreen */
 		setfullscreen(selmon->sel, 0);
 	if (c->mon == selmon)
@@ -1836,9 +2534,6 @@ manage(Window w, XWindowAttributes *wa)
 	c->mon->sel = c;
 	arrange(c->mon); /* recalc based on layout */
 	XMapWindow(dpy, c->win);
-	if (term)
-		swallow(term, c); /* if new window is child of a terminal, replace terminal (swallow) */
-	focus(NULL); /* focus the client */
 }
 
 void
@@ -1847,20 +2542,18 @@ mappingnotify(XEvent *e)
 	XMappingEvent *ev = &e->xmapping;
 
 	XRefreshKeyboardMapping(ev);
-	if (ev->request == MappingKeyboard)
-		grabkeys();
+	/* layout switchers send these in bursts, regrab once the queue is empty */
+	if (ev->request == MappingKeyboard || ev->request == MappingModifier)
+		keymapdirty = 1;
 }
 
 void
 maprequest(XEvent *e)
 { /* window requests map */
-	static XWindowAttributes wa; /* wa will now hold window attributes */
 	XMapRequestEvent *ev = &e->xmaprequest;
 
-	if (!XGetWindowAttributes(dpy, ev->window, &wa) || wa.override_redirect)
-		return; /* gets window geom and data */
 	if (!wintoclient(ev->window)) /* if window is not already managed by dwm */
-		manage(ev->window, &wa); /* call manage to start managing it */
+		manage(ev->window); /* attributes come with the properties, see manage() */
 }
 
 void
@@ -1982,10 +2675,12 @@ propertynotify(XEvent *e)
 	Client *c;
 	Window trans;
 	XPropertyEvent *ev = &e->xproperty;
+	char oldname[sizeof c->name];
 
-	if ((ev->window == root) && (ev->atom == XA_WM_NAME))
-		updatestatus();
-	else if (ev->state == PropertyDelete)
+	if ((ev->window == root) && (ev->atom == XA_WM_NAME)) {
+		if (!nblocks) /* ignored while the status socket has blocks */
+			updatestatus();
+	} else if (ev->state == PropertyDelete)
 		return; /* ignore */
 	else if ((c = wintoclient(ev->window))) {
 		switch(ev->atom) {
@@ -2004,7 +2699,10 @@ propertynotify(XEvent *e)
 			break;
 		}
 		if (ev->atom == XA_WM_NAME || ev->atom == netatom[NetWMName]) {
+			memcpy(oldname, c->name, sizeof oldname);
 			updatetitle(c);
+			if (c->class[0])
+				titlerules(c, oldname);
 			if (c == c->mon->sel && selmon->showtitle)
 				drawbar(c->mon);
 		}
@@ -2079,6 +2777,7 @@ resizeclient(Client *c, int x, int y, int w, int h)
 		wc.border_width = c->bw;
 	XConfigureWindow(dpy, c->win, CWX|CWY|CWWidth|CWHeight|CWBorderWidth, &wc);
 	configure(c);
+	statedirty = 1;
 	XSync(dpy, False);
 }
 
@@ -2149,6 +2848,7 @@ restack(Monitor *m)
 	drawbar(m);
 	if (!m->sel)
 		return;
+	stackdirty = 1; /* floating and tiled windows may have swapped */
 	if (m->sel->isfloating || !m->lt[m->sellt]->arrange)
 		XRaiseWindow(dpy, m->sel->win);
 	if (m->lt[m->sellt]->arrange) {
@@ -2168,38 +2868,367 @@ void
 run(void)
 {
 	XEvent ev; /* store any type of X11 event received - keypress, mouse, etc. */
+	struct pollfd fds[LENGTH(watches) + 1];
+	int i, j, n;
+
 	/* main event loop */
 	XSync(dpy, False); /* all pending X11 requests sent to X server */
-	while (running && !XNextEvent(dpy, &ev)) /* keep running while dwm is supposed to be running, and keep handling events from X */
-		if (handler[ev.type]) /* check if there's a handler for the event type */
-			handler[ev.type](&ev); /* call that handler and pass it the event data */
-}
+	while (running) {
+		/* XPending flushes our requests and reads whatever the server sent */
+		while (running && XPending(dpy)) {
+			XNextEvent(dpy, &ev);
+			if (handler[ev.type]) /* check if there's a handler for the event type */
+				handler[ev.type](&ev); /* call that handler and pass it the event data */
+			if (keymapdirty && !XPending(dpy)) {
+				keymapdirty = 0;
+				grabkeys();
+			}
+		}
+		/* publish what the events changed, once per drained queue */
+		updateclientlist();
+		updatedesktops();
+		ipcflush();
+		statepublish();
+		XFlush(dpy);
+		if (dumpstats) { /* SIGUSR1 asked for cache statistics */
+			dumpstats = 0;
+			drw_fontset_stats(drw);
+#ifdef __linux__
+			pthread_mutex_lock(&proclock);
+			proc_stats(&proccache);
+			pthread_mutex_unlock(&proclock);
+#endif /* __linux__ */
+		}
+		if (!running)
+			break;
+		/* sleep until X or one of the watched descriptors has input */
+		fds[0].fd = ConnectionNumber(dpy);
+		fds[0].events = POLLIN;
+		for (n = 0; n < nwatches; n++) {
+			fds[n + 1].fd = watches[n].fd;
+			fds[n + 1].events = watches[n].events;
+		}
+		if (poll(fds, n + 1, -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			die("poll:");
+		}
+		/* handlers may add or remove watches, so look each one up again */
+		for (i = 1; i <= n; i++)
+			if (fds[i].revents)
+				for (j = 0; j < nwatches; j++)
+					if (watches[j].fd == fds[i].fd) {
+						watches[j].func(fds[i].fd, fds[i].revents);
+						break;
+					}
+	}
+}
 
 void
 scan(void)
 {
-	unsigned int i, num;
-	Window d1, d2, *wins = NULL;
+	xcb_query_tree_reply_t *tree;
+	xcb_window_t *wins;
+	xcb_get_window_attributes_cookie_t *acook;
+	xcb_get_geometry_cookie_t *gcook;
+	xcb_get_property_cookie_t *scook, (*pcook)[PropLast];
+	xcb_get_window_attributes_reply_t *attr;
+	xcb_get_geometry_reply_t *geom;
+	xcb_get_property_reply_t *state, *(*r)[PropLast];
+	XWindowAttributes *wa;
+	unsigned char *want;
+	unsigned int i, j, num, pass;
+
+	if (!(tree = xcb_query_tree_reply(xcon, xcb_query_tree(xcon, root), NULL))) {
+		restorestack();
+		dropretained();
+		return;
+	}
+	wins = xcb_query_tree_children(tree);
+	num = xcb_query_tree_children_length(tree);
+	acook = ecalloc(num + 1, sizeof(*acook));
+	gcook = ecalloc(num + 1, sizeof(*gcook));
+	scook = ecalloc(num + 1, sizeof(*scook));
+	pcook = ecalloc(num + 1, sizeof(*pcook));
+	r = ecalloc(num + 1, sizeof(*r));
+	wa = ecalloc(num + 1, sizeof(*wa));
+	want = ecalloc(num + 1, sizeof(*want));
+
+	/* one round trip for the attributes, geometry and WM_STATE of every
+	 * child, then one for the properties of those that will be managed */
+	for (i = 0; i < num; i++) {
+		acook[i] = xcb_get_window_attributes(xcon, wins[i]);
+		gcook[i] = xcb_get_geometry(xcon, wins[i]);
+		scook[i] = xcb_get_property(xcon, 0, wins[i], wmatom[WMState], wmatom[WMState], 0, 2);
+	}
+	for (i = 0; i < num; i++) {
+		attr = xcb_get_window_attributes_reply(xcon, acook[i], NULL);
+		geom = xcb_get_geometry_reply(xcon, gcook[i], NULL);
+		state = xcb_get_property_reply(xcon, scook[i], NULL);
+		if (attr && geom && !attr->override_redirect
+		&& (attr->map_state == XCB_MAP_STATE_VIEWABLE || savedclient(wins[i])
+		|| (state && state->format == 32 && xcb_get_property_value_length(state) >= 4
+		&& *(uint32_t *)xcb_get_property_value(state) == IconicState))) {
+			wa[i].x = geom->x;
+			wa[i].y = geom->y;
+			wa[i].width = geom->width;
+			wa[i].height = geom->height;
+			wa[i].border_width = geom->border_width;
+			wa[i].map_state = attr->map_state;
+			requestprops(wins[i], pcook[i]);
+			want[i] = 1;
+		}
+		free(attr);
+		free(geom);
+		free(state);
+	}
+	for (i = 0; i < num; i++)
+		if (want[i])
+			for (j = 0; j < PropLast; j++)
+				r[i][j] = xcb_get_property_reply(xcon, pcook[i][j], NULL);
+
+	/* transients last, so their parent is managed already; lay out once */
+	holdarrange();
+	for (pass = 0; pass < 2; pass++)
+		for (i = 0; i < num; i++)
+			if (want[i] && pass == (r[i][PropTransient]
+			&& xcb_get_property_value_length(r[i][PropTransient]) >= 4))
+				managewin(wins[i], &wa[i], r[i]);
+	restorestack();
+	releasearrange();
+	dropretained();
+
+	for (i = 0; i < num; i++)
+		for (j = 0; j < PropLast; j++)
+			free(r[i][j]);
+	free(acook);
+	free(gcook);
+	free(scook);
+	free(pcook);
+	free(r);
+	free(wa);
+	free(want);
+	free(tree);
+}
+
+/**
+ * @brief Read the state a restarting dwm left in _DWM_STATE
+ * @note Restores the per-monitor state right away, before the bars exist;
+ *       client records are picked up by managewin() while scan() runs
+ * @note The property is deleted, a later plain start begins afresh
+ */
+void
+loadstate(void)
+{
+	Atom type;
+	int format, flags;
+	unsigned long n, extra, i;
+	unsigned char *p = NULL;
+	const long *sm;
+	Monitor *m;
+
+	if (XGetWindowProperty(dpy, root, dwmstate, 0L, 1L << 20, True, XA_CARDINAL,
+		&type, &format, &n, &extra, &p) != Success || !p)
+		return;
+	if (format != 32 || n < StLast || ((long *)p)[StVersion] != STATEVERSION
+	|| ((long *)p)[StMons] < 0 || ((long *)p)[StClients] < 0
+	|| n != StLast + ((long *)p)[StMons] * SmLast + ((long *)p)[StClients] * ScLast) {
+		XFree(p);
+		return;
+	}
+	saved = ecalloc(n, sizeof(long));
+	memcpy(saved, p, n * sizeof(long));
+	XFree(p);
+	retained = saved[StRetained];
+	for (i = 0; i < (unsigned long)saved[StMons]; i++) {
+		sm = &saved[StLast + i * SmLast];
+		for (m = mons; m && m->num != sm[SmNum]; m = m->next);
+		if (!m)
+			continue;
+		if (sm[SmTagset0] & TAGMASK)
+			m->tagset[0] = sm[SmTagset0] & TAGMASK;
+		if (sm[SmTagset1] & TAGMASK)
+			m->tagset[1] = sm[SmTagset1] & TAGMASK;
+		m->seltags = sm[SmSeltags] & 1;
+		m->sellt = sm[SmSellt] & 1;
+		if (layoutat(sm[SmLt0]))
+			m->lt[0] = layoutat(sm[SmLt0]);
+		if (layoutat(sm[SmLt1]))
+			m->lt[1] = layoutat(sm[SmLt1]);
+		strncpy(m->ltsymbol, m->lt[m->sellt]->symbol, sizeof m->ltsymbol);
+		m->mfact = TRUNC(sm[SmMfact] / 10000.0, 0.05, 0.95);
+		m->nmaster = MAX(sm[SmNmaster], 0);
+		m->gappih = sm[SmGappih];
+		m->gappiv = sm[SmGappiv];
+		m->gappoh = sm[SmGappoh];
+		m->gappov = sm[SmGappov];
+		flags = sm[SmFlags];
+		m->showbar = !!(flags & 1);
+		m->showtitle = !!(flags & 2);
+		m->showtags = !!(flags & 4);
+		m->showlayout = !!(flags & 8);
+		m->showstatus = !!(flags & 16);
+		m->showfloating = !!(flags & 32);
+		m->topbar = !!(flags & 64);
+		updatebarpos(m);
+		if (m->num == saved[StSelmon])
+			selmon = m;
+	}
+}
+
+/**
+ * @brief Take over what a client looked like before the restart
+ * @param c Client being managed, instead of applyrules()
+ * @param s Its _DWM_STATE record
+ * @note A terminal that was swallowing gets its hidden window back, so
+ *       closing the swallowing window still brings the terminal back
+ */
+void
+restoreclient(Client *c, const long *s)
+{
 	XWindowAttributes wa;
+	Monitor *m;
 
-	if (XQueryTree(dpy, root, &d1, &d2, &wins, &num)) {
-		for (i = 0; i < num; i++) {
-			if (!XGetWindowAttributes(dpy, wins[i], &wa)
-			|| wa.override_redirect || XGetTransientForHint(dpy, wins[i], &d1))
-				continue;
-			if (wa.map_state == IsViewable || getstate(wins[i]) == IconicState)
-				manage(wins[i], &wa);
-		}
-		for (i = 0; i < num; i++) { /* now the transients */
-			if (!XGetWindowAttributes(dpy, wins[i], &wa))
-				continue;
-			if (XGetTransientForHint(dpy, wins[i], &d1)
-			&& (wa.map_state == IsViewable || getstate(wins[i]) == IconicState))
-				manage(wins[i], &wa);
+	for (m = mons; m && m->num != s[ScMon]; m = m->next);
+	c->mon = m ? m : selmon;
+	c->isfloating = !!(s[ScFlags] & 1);
+	c->issticky = !!(s[ScFlags] & 2);
+	c->isterminal = !!(s[ScFlags] & 4);
+	c->noswallow = !!(s[ScFlags] & 8);
+	c->hasfloatbw = !!(s[ScFlags] & 16);
+	c->scratchkey = (char)s[ScScratchkey];
+	c->floatborderpx = s[ScFloatbw];
+	c->pid = s[ScPid];
+	c->tags = s[ScTags] & TAGMASK;
+	if (!c->tags && !c->scratchkey) /* hidden scratchpads have no tags */
+		c->tags = c->mon->tagset[c->mon->seltags];
+	if (s[ScSwallowed] && XGetWindowAttributes(dpy, s[ScSwallowed], &wa)) {
+		c->swallowing = ecalloc(1, sizeof(Client));
+		c->swallowing->win = s[ScSwallowed];
+		c->swallowing->mon = c->mon;
+		XSelectInput(dpy, c->swallowing->win, EnterWindowMask|FocusChangeMask|PropertyChangeMask|StructureNotifyMask);
+		grabbuttons(c->swallowing, 0);
+	}
+}
+
+/**
+ * @brief Put restored clients back in their saved order and selection
+ * @note Ends a restore, the saved state is freed
+ */
+void
+restorestack(void)
+{
+	const long *sm;
+	Monitor *m;
+	Client *c;
+	long i;
+
+	if (!saved)
+		return;
+	/* attach() prepends, so walk the records backwards */
+	for (i = saved[StClients] - 1; i >= 0; i--) {
+		if (!(c = wintoclient(saved[StLast + saved[StMons] * SmLast + i * ScLast + ScWin])))
+			continue;
+		detach(c);
+		attach(c);
+	}
+	for (i = 0; i < saved[StMons]; i++) {
+		sm = &saved[StLast + i * SmLast];
+		for (m = mons; m && m->num != sm[SmNum]; m = m->next);
+		if (m && (c = wintoclient(sm[SmSel])) && c->mon == m) {
+			detachstack(c);
+			attachstack(c);
 		}
-		if (wins)
-			XFree(wins);
 	}
+	free(saved);
+	saved = NULL;
+}
+
+/**
+ * @brief Find a window's record in the state left by a restart
+ * @param w Window being managed
+ * @return The record, NULL if w was not managed before the restart
+ */
+const long *
+savedclient(Window w)
+{
+	const long *s;
+	long i;
+
+	if (!saved)
+		return NULL;
+	s = &saved[StLast + saved[StMons] * SmLast];
+	for (i = 0; i < saved[StClients]; i++, s += ScLast)
+		if ((Window)s[ScWin] == w)
+			return s;
+	return NULL;
+}
+
+/**
+ * @brief Leave clients, tags and layouts in _DWM_STATE for the next dwm
+ * @note Called right before a restart exec; the record formats are the
+ *       St*, Sm* and Sc* enums, stored as 32-bit CARDINALs on the root
+ */
+void
+savestate(void)
+{
+	Monitor *m;
+	Client *c;
+	long *st, *p;
+	long nmons = 0, nclients = 0;
+
+	for (m = mons; m; m = m->next, nmons++)
+		for (c = m->clients; c; c = c->next)
+			nclients++;
+	st = ecalloc(StLast + nmons * SmLast + nclients * ScLast, sizeof(long));
+	st[StVersion] = STATEVERSION;
+	st[StMons] = nmons;
+	st[StClients] = nclients;
+	st[StSelmon] = selmon->num;
+	st[StRetained] = seamlessrestart ? mons->barwin : None;
+	for (p = st + StLast, m = mons; m; m = m->next, p += SmLast) {
+		p[SmNum] = m->num;
+		p[SmTagset0] = m->tagset[0];
+		p[SmTagset1] = m->tagset[1];
+		p[SmSeltags] = m->seltags;
+		p[SmSellt] = m->sellt;
+		p[SmLt0] = layoutindex(m->lt[0]);
+		p[SmLt1] = layoutindex(m->lt[1]);
+		p[SmMfact] = (long)(m->mfact * 10000 + 0.5);
+		p[SmNmaster] = m->nmaster;
+		p[SmGappih] = m->gappih;
+		p[SmGappiv] = m->gappiv;
+		p[SmGappoh] = m->gappoh;
+		p[SmGappov] = m->gappov;
+		p[SmFlags] = m->showbar | m->showtitle << 1 | m->showtags << 2
+		           | m->showlayout << 3 | m->showstatus << 4
+		           | m->showfloating << 5 | m->topbar << 6;
+		p[SmSel] = m->sel ? m->sel->win : None;
+	}
+	for (m = mons; m; m = m->next)
+		for (c = m->clients; c; c = c->next, p += ScLast) {
+			p[ScWin] = c->win;
+			p[ScMon] = m->num;
+			p[ScTags] = c->tags;
+			p[ScFlags] = c->isfloating | c->issticky << 1 | c->isterminal << 2
+			           | c->noswallow << 3 | c->hasfloatbw << 4;
+			p[ScScratchkey] = c->scratchkey;
+			p[ScFloatbw] = c->floatborderpx;
+			p[ScPid] = c->pid;
+			p[ScX] = c->x;
+			p[ScY] = c->y;
+			p[ScW] = c->w;
+			p[ScH] = c->h;
+			p[ScSfx] = c->sfx;
+			p[ScSfy] = c->sfy;
+			p[ScSfw] = c->sfw;
+			p[ScSfh] = c->sfh;
+			p[ScSwallowed] = c->swallowing ? c->swallowing->win : None;
+		}
+	XChangeProperty(dpy, root, dwmstate, XA_CARDINAL, 32, PropModeReplace,
+		(unsigned char *)st, p - st);
+	XSync(dpy, False); /* the connection goes away with the exec */
+	free(st);
 }
 
 void
@@ -2218,6 +3247,37 @@ sendmon(Client *c, Monitor *m)
 	arrange(NULL);
 }
 
+/**
+ * @brief Edit the client list published as _NET_CLIENT_LIST
+ * @param old Window to replace or remove, None to append new
+ * @param new Window to put in its place, None to remove old
+ * @note Nothing is written here, updateclientlist() publishes the result
+ *       once the X queue drains
+ */
+void
+setclientlist(Window old, Window new)
+{
+	unsigned int i;
+	Window *l;
+
+	for (i = 0; old && i < nclientlist && clientlist[i] != old; i++);
+	if (old && i == nclientlist)
+		return;
+	if (!old) {
+		if (nclientlist == clientlistsize) {
+			clientlistsize = clientlistsize ? clientlistsize * 2 : 64;
+			if (!(l = realloc(clientlist, clientlistsize * sizeof(Window))))
+				die("realloc:");
+			clientlist = l;
+		}
+		clientlist[nclientlist++] = new;
+	} else if (new)
+		clientlist[i] = new;
+	else
+		memmove(&clientlist[i], &clientlist[i + 1], (--nclientlist - i) * sizeof(Window));
+	clientlistdirty = 1;
+}
+
 void
 setclientstate(Client *c, long state)
 {
@@ -2302,10 +3362,12 @@ void
 			 XChangeProperty(dpy, c->win, netatom[NetWMState], XA_ATOM, 32,
 					 PropModeReplace, (unsigned char *) &netatom[NetWMSticky], 1);
 			 c->issticky = 1;
+			 desktopdirty = statedirty = 1; /* no arrange follows */
 		 } else if(!sticky && c->issticky){
 			 XChangeProperty(dpy, c->win, netatom[NetWMState], XA_ATOM, 32,
 					 PropModeReplace, (unsigned char *)0, 0);
 			 c->issticky = 0;
+			 desktopdirty = statedirty = 1;
 			 arrange(c->mon);
 		 }
 	 }
@@ -2319,6 +3381,8 @@ setlayout(const Arg *arg)
 	if (arg && arg->v)
 		selmon->lt[selmon->sellt] = (Layout *)arg->v;
 	strncpy(selmon->ltsymbol, selmon->lt[selmon->sellt]->symbol, sizeof selmon->ltsymbol);
+	ipcevent(EvLayout, None);
+	statedirty = 1;
 	if (selmon->sel)
 		arrange(selmon);
 	else
@@ -2344,6 +3408,8 @@ void
 setup(void)
 {
 	int i;
+	size_t n;
+	char *names;
 	XSetWindowAttributes wa;
 	Atom utf8string;
 	struct sigaction sa;
@@ -2359,6 +3425,7 @@ setup(void)
 
 	signal(SIGHUP, sighup);
 	signal(SIGTERM, sigterm);
+	signal(SIGUSR1, sigusr1);
 
 	/* init screen */
 	screen = DefaultScreen(dpy); /* gets the default screen number from the display (dpy) */
@@ -2368,6 +3435,7 @@ setup(void)
 	drw = drw_create(dpy, screen, root, sw, sh); /* a drawing context for rendering the UI (like the bar) */
 	if (!drw_fontset_create(drw, fonts, LENGTH(fonts)))
 		die("no fonts could be loaded.");
+	drw_fontset_setfallback(drw, fallbackfonts, fallbackglyphmem);
 	lrpad = drw->fonts->h; /* sets lrpad to the height of the font, for correct spacing in bar */
 	bh = drw->fonts->h + 2;
 	updategeom(); /* setting up monitor geometry, if using multiple monitors, creates a linked list of monitor structs */
@@ -2379,6 +3447,7 @@ setup(void)
 	wmatom[WMDelete] = XInternAtom(dpy, "WM_DELETE_WINDOW", False);
 	wmatom[WMState] = XInternAtom(dpy, "WM_STATE", False);
 	wmatom[WMTakeFocus] = XInternAtom(dpy, "WM_TAKE_FOCUS", False);
+	dwmstate = XInternAtom(dpy, "_DWM_STATE", False);
 	netatom[NetActiveWindow] = XInternAtom(dpy, "_NET_ACTIVE_WINDOW", False);
 	netatom[NetSupported] = XInternAtom(dpy, "_NET_SUPPORTED", False);
 	netatom[NetWMName] = XInternAtom(dpy, "_NET_WM_NAME", False);
@@ -2389,6 +3458,11 @@ setup(void)
 	netatom[NetWMWindowType] = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE", False);
 	netatom[NetWMWindowTypeDialog] = XInternAtom(dpy, "_NET_WM_WINDOW_TYPE_DIALOG", False);
 	netatom[NetClientList] = XInternAtom(dpy, "_NET_CLIENT_LIST", False);
+	netatom[NetClientListStacking] = XInternAtom(dpy, "_NET_CLIENT_LIST_STACKING", False);
+	netatom[NetCurrentDesktop] = XInternAtom(dpy, "_NET_CURRENT_DESKTOP", False);
+	netatom[NetNumberOfDesktops] = XInternAtom(dpy, "_NET_NUMBER_OF_DESKTOPS", False);
+	netatom[NetDesktopNames] = XInternAtom(dpy, "_NET_DESKTOP_NAMES", False);
+	netatom[NetWMDesktop] = XInternAtom(dpy, "_NET_WM_DESKTOP", False);
 	/* init cursors */
 	cursor[CurNormal] = drw_cur_create(drw, XC_left_ptr);
 	cursor[CurResize] = drw_cur_create(drw, XC_sizing);
@@ -2398,8 +3472,17 @@ setup(void)
 	for (i = 0; i < LENGTH(colors); i++)
 		scheme[i] = drw_scm_create(drw, colors[i], 3); /* each scheme[i] corresponds to a SchemeNorm, SchemeSel, etc */
 	/* init bars */
+	plugininit(); /* layout plugins, before a restart's layouts refer to them */
+	loadstate(); /* state left by a restart, before the bars are placed */
 	updatebars(); /* creates a bar window for each monitor */
 	updatestatus(); /* renders the status text */
+	statusinit(); /* listen for status blocks */
+	rcinit(); /* overlay and watch rcfile */
+	ipcinit(); /* listen for commands */
+	stateinit(); /* map the shared state snapshot */
+#ifdef __linux__
+	pidinit(); /* resolve pids and swallows off the main thread */
+#endif /* __linux__ */
 	/* supporting window for NetWMCheck */
 	wmcheckwin = XCreateSimpleWindow(dpy, root, 0, 0, 1, 1, 0, 0, 0); /* a dummy window created so applications can detect the WM */
 	/* setting X11 properties so applications know that dwm is the window manager, and supports EWMH hints */
@@ -2413,6 +3496,18 @@ setup(void)
 	XChangeProperty(dpy, root, netatom[NetSupported], XA_ATOM, 32,
 		PropModeReplace, (unsigned char *) netatom, NetLast);
 	XDeleteProperty(dpy, root, netatom[NetClientList]);
+	XDeleteProperty(dpy, root, netatom[NetClientListStacking]);
+	/* one desktop per tag, named after it */
+	XChangeProperty(dpy, root, netatom[NetNumberOfDesktops], XA_CARDINAL, 32,
+		PropModeReplace, (unsigned char *) &(long){ LENGTH(tags) }, 1);
+	for (i = 0, n = 0; i < LENGTH(tags); i++)
+		n += strlen(tags[i]) + 1;
+	names = ecalloc(1, n);
+	for (i = 0, n = 0; i < LENGTH(tags); i++)
+		n += strlen(strcpy(names + n, tags[i])) + 1;
+	XChangeProperty(dpy, root, netatom[NetDesktopNames], utf8string, 8,
+		PropModeReplace, (unsigned char *) names, n);
+	free(names);
 	/* select events */
 	wa.cursor = cursor[CurNormal]->cursor;
 	wa.event_mask = SubstructureRedirectMask|SubstructureNotifyMask
@@ -2421,6 +3516,7 @@ setup(void)
 	XChangeWindowAttributes(dpy, root, CWEventMask|CWCursor, &wa); /* applies the event mask and cursor to the root window */
 	XSelectInput(dpy, root, wa.event_mask);
 	grabkeys(); /* register the keybinds in config.h */
+	buildrules(); /* index rules[] for applyrules */
 	focus(NULL); /* focus needs to start cleanly */
 }
 
@@ -2430,6 +3526,10 @@ seturgent(Client *c, int urg)
 	XWMHints *wmh;
 
 	c->isurgent = urg;
+	ipcevent(EvTags, None);
+	if (urg)
+		ipcevent(EvUrgent, c->win);
+	statedirty = 1;
 	if (!(wmh = XGetWMHints(dpy, c->win)))
 		return;
 	wmh->flags = urg ? (wmh->flags | XUrgencyHint) : (wmh->flags & ~XUrgencyHint);
@@ -2456,11 +3556,28 @@ showhide(Client *c)
 }
 
 
+/**
+ * @brief First slot to probe for a keysym in symcodes
+ * @param sym Keysym to look up
+ * @return Index into symcodes
+ */
+unsigned int
+symslot(KeySym sym)
+{
+	unsigned int h = (unsigned int)sym * 2654435761u;
+
+	return (h ^ h >> 16) & symmask;
+}
+
 void
 sigstatusbar(const Arg *arg)
 {
 	union sigval sv;
 
+	if (nblocks) {
+		statusclick(arg->i);
+		return;
+	}
 	if (!statussig)
 		return;
 	sv.sival_int = arg->i;
@@ -2485,6 +3602,12 @@ sigterm(int unused)
 	quit(&a);
 }
 
+void
+sigusr1(int unused)
+{
+	dumpstats = 1;
+}
+
 void
 spawn(const Arg *arg)
 { /* runs shell commands, ie. launching programs from keybinds */
@@ -2507,6 +3630,96 @@ spawn(const Arg *arg)
 	}
 }
 
+/**
+ * @brief Run a shell command without waiting for it
+ * @param cmd Command line passed to /bin/sh -c
+ * @param env "NAME=value" added to the command's environment, or NULL
+ * @param done Called from the event loop with the collected output
+ * @param id Stored in the job for done to identify the caller
+ * @return The running job, or NULL if it could not be started
+ * @note The child is reaped by the SIGCHLD setup in setup()
+ * @note This is how bindings use a command's output without blocking the
+ *       event loop, see quitprompt() and the status engine
+ */
+Job *
+runjob(const char *cmd, char *env, void (*done)(Job *j), int id)
+{
+	struct sigaction sa;
+	Job *j;
+	int fds[2];
+
+	if (pipe(fds) < 0)
+		return NULL;
+	if (watchfd(fds[0], POLLIN, jobread) < 0) { /* nothing would ever read it */
+		close(fds[0]);
+		close(fds[1]);
+		return NULL;
+	}
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	j = ecalloc(1, sizeof(Job));
+	if ((j->pid = fork()) == 0) {
+		if (dpy)
+			close(ConnectionNumber(dpy));
+		setsid();
+
+		sigemptyset(&sa.sa_mask);
+		sa.sa_flags = 0;
+		sa.sa_handler = SIG_DFL;
+		sigaction(SIGCHLD, &sa, NULL);
+
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[1]);
+		if (env)
+			putenv(env);
+		execl("/bin/sh", "sh", "-c", cmd, (char *)NULL);
+		die("dwm: execl '%s' failed:", cmd);
+	}
+	close(fds[1]);
+	if (j->pid < 0) {
+		unwatchfd(fds[0]);
+		close(fds[0]);
+		free(j);
+		return NULL;
+	}
+	j->fd = fds[0];
+	j->done = done;
+	j->id = id;
+	j->next = jobs;
+	jobs = j;
+	return j;
+}
+
+void
+jobread(int fd, short revents)
+{
+	Job *j, **jp;
+	char discard[256];
+	ssize_t n;
+
+	for (jp = &jobs; *jp && (*jp)->fd != fd; jp = &(*jp)->next);
+	if (!(j = *jp))
+		return;
+	for (;;) {
+		if (j->len < sizeof(j->out) - 1)
+			n = read(fd, j->out + j->len, sizeof(j->out) - 1 - j->len);
+		else
+			n = read(fd, discard, sizeof(discard));
+		if (n < 0 && (errno == EAGAIN || errno == EINTR))
+			return; /* more to come */
+		if (n <= 0)
+			break;
+		if (j->len < sizeof(j->out) - 1)
+			j->len += n;
+	}
+	*jp = j->next;
+	unwatchfd(fd);
+	close(fd);
+	j->out[j->len] = '\0';
+	j->done(j);
+	free(j);
+}
+
 void spawnscratch(const Arg *arg)
 {
 	struct sigaction sa;
@@ -2568,6 +3781,62 @@ tag(const Arg *arg)
 	}
 }
 
+/**
+ * @brief Apply the title rules a client's new title starts to match
+ * @param c Client whose title changed, managed through applyrules()
+ * @param oldname Title before the change
+ * @note Many programs set their final title after mapping. Rules that
+ *       matched the old title already had their chance, so windows the
+ *       user has moved since are left alone
+ */
+void
+titlerules(Client *c, const char *oldname)
+{
+	unsigned char *hnew = rulehit, *hold = hnew + nruletab, *hclass = hold + nruletab, *hinstance = hclass + nruletab;
+	unsigned int i, oldtags = c->tags, ruletags;
+	int x = c->x, y = c->y, w = c->w, h = c->h, nx, ny, nw, nh, applied = 0;
+	const Rule *r;
+	Monitor *m = c->mon, *target;
+
+	memset(rulehit, 0, 4 * nruletab);
+	match_run(&ruletitle, c->name, hnew);
+	match_run(&ruletitle, oldname, hold);
+	for (i = 0; i < nruletab && !(hnew[i] && !hold[i]); i++);
+	if (i == nruletab)
+		return;
+	match_run(&ruleclass, c->class, hclass);
+	match_run(&ruleinstance, c->instance, hinstance);
+	c->tags = 0;
+	for (i = 0; i < nruletab; i++) {
+		r = &ruletab[i];
+		if (r->title && hnew[i] && !hold[i]
+		&& (!r->class || hclass[i])
+		&& (!r->instance || hinstance[i])) {
+			applyrule(c, r);
+			applied = 1;
+		}
+	}
+	ruletags = c->tags & TAGMASK;
+	c->tags = oldtags;
+	if (!applied)
+		return;
+	/* applyrule() only set fields, move the window like a user would */
+	nx = c->x, ny = c->y, nw = c->w, nh = c->h;
+	c->x = x, c->y = y, c->w = w, c->h = h;
+	target = c->mon;
+	c->mon = m;
+	/* one layout once the window has its rule's monitor and tags, sendmon()
+	 * alone would show it on the target's current tags first */
+	holdarrange();
+	sendmon(c, target);
+	if (ruletags)
+		c->tags = ruletags;
+	if (c->isfloating)
+		resize(c, nx, ny, nw, nh, 0);
+	arrange(NULL); /* marks the retag, releasearrange() focuses and lays out */
+	releasearrange();
+}
+
 void
 spawntag(const Arg *arg)
 {
@@ -2775,6 +4044,7 @@ unmanage(Client *c, int destroyed)
 
 	detach(c); /* remove c from the monitor's client list */
 	detachstack(c); /* remove c from the stacking order */
+	setclientlist(c->win, None);
 	if (!destroyed) { /* restore X11 properties if not destroyed */
 		wc.border_width = c->oldbw;
 		XGrabServer(dpy); /* avoid race conditions */
@@ -2782,6 +4052,7 @@ unmanage(Client *c, int destroyed)
 		XSelectInput(dpy, c->win, NoEventMask);
 		XConfigureWindow(dpy, c->win, CWBorderWidth, &wc); /* restore border */
 		XUngrabButton(dpy, AnyButton, AnyModifier, c->win);
+		XDeleteProperty(dpy, c->win, netatom[NetWMDesktop]);
 		setclientstate(c, WithdrawnState);
 		XSync(dpy, False);
 		XSetErrorHandler(xerror);
@@ -2795,10 +4066,61 @@ unmanage(Client *c, int destroyed)
 	if(fullscreen){ /* if fullscreen, toggle it off */
 		togglefullscreen(NULL);
 	}
-		updateclientlist(); /* update EWMH property */
 	}
 }
 
+/**
+ * @brief Give every client window back to the X server at shutdown
+ * @note unmanage() grabs the server, syncs, relayouts and refocuses per
+ *       window; here all restore requests go out under a single grab and
+ *       sync, and nothing is laid out since dwm is going away
+ * @note Swallowed terminals are mapped again where their swallower was,
+ *       clients still waiting for a swallow are mapped as they are
+ */
+void
+unmanageall(void)
+{
+	XWindowChanges wc;
+	Monitor *m;
+	Client *c, *s;
+
+	XGrabServer(dpy);
+	XSetErrorHandler(xerrordummy);
+	for (m = mons; m; m = m->next) {
+		while ((c = m->stack)) {
+			detach(c);
+			detachstack(c);
+			wc.border_width = c->oldbw;
+			for (;;) {
+				XSelectInput(dpy, c->win, NoEventMask);
+				XConfigureWindow(dpy, c->win, CWBorderWidth, &wc);
+				XUngrabButton(dpy, AnyButton, AnyModifier, c->win);
+				XDeleteProperty(dpy, c->win, netatom[NetWMDesktop]);
+				setclientstate(c, WithdrawnState);
+				if (c->swallowpending) { /* still where manage() parked it */
+					XMoveResizeWindow(dpy, c->win, c->x, c->y, c->w, c->h);
+					XMapWindow(dpy, c->win);
+				}
+				if (!(s = c->swallowing))
+					break;
+				c->win = s->win;
+				c->swallowing = NULL;
+				free(s);
+				XMoveResizeWindow(dpy, c->win, c->x, c->y, c->w, c->h);
+				XMapWindow(dpy, c->win);
+			}
+			free(c);
+		}
+		m->sel = NULL;
+	}
+	nclientlist = 0;
+	XDeleteProperty(dpy, root, netatom[NetClientList]);
+	XDeleteProperty(dpy, root, netatom[NetClientListStacking]);
+	XSync(dpy, False);
+	XSetErrorHandler(xerror);
+	XUngrabServer(dpy);
+}
+
 void
 unmapnotify(XEvent *e)
 {
@@ -2813,6 +4135,23 @@ unmapnotify(XEvent *e)
 	}
 }
 
+/**
+ * @brief Stop multiplexing a descriptor into the event loop
+ * @param fd Descriptor registered with watchfd
+ * @note The descriptor itself is left open
+ */
+void
+unwatchfd(int fd)
+{
+	int i;
+
+	for (i = 0; i < nwatches; i++)
+		if (watches[i].fd == fd) {
+			watches[i] = watches[--nwatches];
+			return;
+		}
+}
+
 void
 updatebars(void)
 {
@@ -2830,7 +4169,8 @@ updatebars(void)
 				CopyFromParent, DefaultVisual(dpy, screen),
 				CWOverrideRedirect|CWBackPixmap|CWEventMask, &wa);
 		XDefineCursor(dpy, m->barwin, cursor[CurNormal]->cursor);
-		XMapRaised(dpy, m->barwin);
+		if (!retained) /* mapped by dropretained() once there is a bar to show */
+			XMapRaised(dpy, m->barwin);
 		XSetClassHint(dpy, m->barwin, &ch);
 	}
 }
@@ -2848,18 +4188,102 @@ updatebarpos(Monitor *m)
 		m->by = -bh;
 }
 
+/**
+ * @brief Publish _NET_CLIENT_LIST and _NET_CLIENT_LIST_STACKING
+ * @note Called once the X queue drains; each property is written with a
+ *       single request, and only if it changed since the last call
+ * @note The stacking list runs bottom to top: per monitor, tiled windows
+ *       below floating ones, each in reverse focus order as restack()
+ *       leaves them
+ */
 void
 updateclientlist(void)
 {
+	static Window *stacking, *next;
+	static unsigned int nstacking, stackingsize;
+	unsigned int n;
+	Monitor *m;
 	Client *c;
+	int floating;
+
+	if (!clientlistdirty && !stackdirty)
+		return;
+	if (clientlistdirty)
+		XChangeProperty(dpy, root, netatom[NetClientList], XA_WINDOW, 32,
+			PropModeReplace, (unsigned char *)clientlist, nclientlist);
+	clientlistdirty = 0;
+	if (!stackdirty)
+		return;
+	stackdirty = 0;
+	for (n = 0, m = mons; m; m = m->next)
+		for (c = m->stack; c; c = c->snext, n++);
+	if (n > stackingsize) {
+		stackingsize = n * 2;
+		free(stacking);
+		free(next);
+		stacking = ecalloc(stackingsize, sizeof(Window));
+		next = ecalloc(stackingsize, sizeof(Window));
+		nstacking = stackingsize + 1; /* forces a write */
+	}
+	/* filled from the top down */
+	n = stackingsize;
+	for (m = mons; m; m = m->next)
+		for (floating = 1; floating >= 0; floating--)
+			for (c = m->stack; c; c = c->snext)
+				if (c->isfloating == floating)
+					next[--n] = c->win;
+	if (stackingsize - n == nstacking && !memcmp(next + n, stacking + n, nstacking * sizeof(Window)))
+		return;
+	nstacking = stackingsize - n;
+	memcpy(stacking + n, next + n, nstacking * sizeof(Window));
+	XChangeProperty(dpy, root, netatom[NetClientListStacking], XA_WINDOW, 32,
+		PropModeReplace, (unsigned char *)(stacking + n), nstacking);
+}
+
+/**
+ * @brief Publish _NET_CURRENT_DESKTOP and each client's _NET_WM_DESKTOP
+ * @note Desktops are tags, a window or view spanning several is on the
+ *       lowest; a window on every tag is on all desktops (0xffffffff) and
+ *       a hidden scratchpad on none
+ * @note Called once the X queue drains; clients are only visited after an
+ *       arrange, and a property is only written when its value changed
+ */
+void
+updatedesktops(void)
+{
+	static long current = -1;
+	long d;
 	Monitor *m;
+	Client *c;
+	int i;
 
-	XDeleteProperty(dpy, root, netatom[NetClientList]);
+	for (d = 0; d < (long)LENGTH(tags) - 1 && !(selmon->tagset[selmon->seltags] & 1 << d); d++);
+	if (d != current) {
+		current = d;
+		XChangeProperty(dpy, root, netatom[NetCurrentDesktop], XA_CARDINAL, 32,
+			PropModeReplace, (unsigned char *) &d, 1);
+	}
+	if (!desktopdirty)
+		return;
+	desktopdirty = 0;
 	for (m = mons; m; m = m->next)
-		for (c = m->clients; c; c = c->next)
-			XChangeProperty(dpy, root, netatom[NetClientList],
-				XA_WINDOW, 32, PropModeAppend,
-				(unsigned char *) &(c->win), 1);
+		for (c = m->clients; c; c = c->next) {
+			if (c->issticky || c->tags == TAGMASK)
+				i = LENGTH(tags); /* all */
+			else if (!c->tags)
+				i = -1;
+			else
+				for (i = 0; !(c->tags & 1 << i); i++);
+			if (i == c->desktop)
+				continue;
+			c->desktop = i;
+			d = i == LENGTH(tags) ? 0xffffffff : i;
+			if (i < 0)
+				XDeleteProperty(dpy, c->win, netatom[NetWMDesktop]);
+			else
+				XChangeProperty(dpy, c->win, netatom[NetWMDesktop], XA_CARDINAL, 32,
+					PropModeReplace, (unsigned char *) &d, 1);
+		}
 }
 
 int
@@ -2965,6 +4389,14 @@ updatesizehints(Client *c)
 	if (!XGetWMNormalHints(dpy, c->win, &size, &msize))
 		/* size is uninitialized, ensure that size.flags aren't used */
 		size.flags = PSize;
+	setsizehints(c, &size);
+}
+
+void
+setsizehints(Client *c, XSizeHints *hints)
+{
+	XSizeHints size = *hints;
+
 	if (size.flags & PBaseSize) {
 		c->basew = size.base_width;
 		c->baseh = size.base_height;
@@ -3003,6 +4435,11 @@ updatesizehints(Client *c)
 void
 updatestatus(void)
 {
+	if (nblocks) {
+		statusw = statuswidth();
+		drawbar(selmon);
+		return;
+	}
 	if (!gettextprop(root, XA_WM_NAME, stext, sizeof(stext)) && selmon->showstatus) {
 		strcpy(stext, "dwm-"VERSION);
 		statusw = TEXTW(stext) - lrpad + 2;
@@ -3032,14 +4469,20 @@ updatetitle(Client *c)
 		gettextprop(c->win, XA_WM_NAME, c->name, sizeof c->name);
 	if (c->name[0] == '\0') /* hack to mark broken clients */
 		strcpy(c->name, broken);
+	ipcevent(EvTitle, c->win);
+	statedirty = 1;
 }
 
 void
 updatewindowtype(Client *c)
 {
-	Atom state = getatomprop(c, netatom[NetWMState]);
-	Atom wtype = getatomprop(c, netatom[NetWMWindowType]);
+	setwindowtype(c, getatomprop(c, netatom[NetWMState]),
+		getatomprop(c, netatom[NetWMWindowType]));
+}
 
+void
+setwindowtype(Client *c, Atom state, Atom wtype)
+{
 	if (state == netatom[NetWMFullscreen])
 		setfullscreen(c, 1);
 	if (state == netatom[NetWMSticky]) {
@@ -3055,19 +4498,30 @@ updatewmhints(Client *c)
 	XWMHints *wmh;
 
 	if ((wmh = XGetWMHints(dpy, c->win))) {
-		if (c == selmon->sel && wmh->flags & XUrgencyHint) {
-			wmh->flags &= ~XUrgencyHint;
-			XSetWMHints(dpy, c->win, wmh);
-		} else
-			c->isurgent = (wmh->flags & XUrgencyHint) ? 1 : 0;
-		if (wmh->flags & InputHint)
-			c->neverfocus = !wmh->input;
-		else
-			c->neverfocus = 0;
+		setwmhints(c, wmh);
 		XFree(wmh);
 	}
 }
 
+void
+setwmhints(Client *c, XWMHints *wmh)
+{
+	if (c == selmon->sel && wmh->flags & XUrgencyHint) {
+		wmh->flags &= ~XUrgencyHint;
+		XSetWMHints(dpy, c->win, wmh);
+	} else if (c->isurgent != !!(wmh->flags & XUrgencyHint)) {
+		c->isurgent = !c->isurgent;
+		ipcevent(EvTags, None);
+		if (c->isurgent)
+			ipcevent(EvUrgent, c->win);
+		statedirty = 1;
+	}
+	if (wmh->flags & InputHint)
+		c->neverfocus = !wmh->input;
+	else
+		c->neverfocus = 0;
+}
+
 void
 view(const Arg *arg)
 {
@@ -3133,23 +4587,12 @@ winpid(Window w)
 	return result;
 }
 
+#ifndef __linux__ /* Linux walks the process tree through proccache */
 pid_t
 getparentprocess(pid_t p)
 {
 	unsigned int v = 0;
 
-#ifdef __linux__
-	FILE *f;
-	char buf[256];
-	snprintf(buf, sizeof(buf) - 1, "/proc/%u/stat", (unsigned)p);
-
-	if (!(f = fopen(buf, "r")))
-		return 0;
-
-	fscanf(f, "%*u %*s %*c %u", &v);
-	fclose(f);
-#endif /* __linux__*/
-
 #ifdef __FreeBSD__
     FILE *f;
 	char buf[256];
@@ -3186,7 +4629,243 @@ isdescprocess(pid_t p, pid_t c)
 
 	return (int)c;
 }
+#endif /* __linux__ */
 
+#ifdef __linux__
+/* match every terminal against an ancestry resolved by pidworker */
+Client *
+termforchain(const pid_t *chain, int n)
+{
+	Client *c;
+	Monitor *m;
+	int i;
+
+	for (m = mons; m; m = m->next) {
+		for (c = m->clients; c; c = c->next) {
+			if (!c->isterminal || c->swallowing || !c->pid)
+				continue;
+			for (i = 0; i < n; i++)
+				if (chain[i] == c->pid)
+					return c;
+		}
+	}
+
+	return NULL;
+}
+
+void *
+pidworker(void *unused)
+{
+	PidQuery *q;
+	uint64_t one = 1;
+
+	pthread_mutex_lock(&pidlock);
+	for (;;) {
+		while (pidwork == pidhead && !pidstop)
+			pthread_cond_wait(&pidcond, &pidlock);
+		if (pidstop)
+			break;
+		q = &pidq[pidwork % LENGTH(pidq)];
+		pthread_mutex_unlock(&pidlock);
+
+		/* the slot is ours until pidwork moves past it */
+		q->pid = winpid(q->win);
+		q->n = 0;
+		if (q->pid && q->needchain) {
+			pthread_mutex_lock(&proclock);
+			q->n = proc_ancestors(&proccache, q->pid, q->chain, LENGTH(q->chain));
+			pthread_mutex_unlock(&proclock);
+		}
+
+		pthread_mutex_lock(&pidlock);
+		pidwork++;
+		if (write(pidfd, &one, sizeof(one)) < 0)
+			continue; /* the counter cannot overflow in practice */
+	}
+	pthread_mutex_unlock(&pidlock);
+	return NULL;
+}
+
+/**
+ * @brief Queue a new client for pid and swallow resolution
+ * @param c Client whose window is looked up
+ * @param needchain Non-zero to also resolve the ancestry for swallowing
+ * @return 0 if queued, -1 if the queue was full and only the pid was read
+ */
+int
+pidquery(Client *c, int needchain)
+{
+	PidQuery *q;
+	int queued = 0;
+
+	pthread_mutex_lock(&pidlock);
+	if (pidrunning && pidhead - pidtail < LENGTH(pidq)) {
+		q = &pidq[pidhead % LENGTH(pidq)];
+		q->win = c->win;
+		q->seq = c->pidseq = pidhead + 1;
+		q->needchain = needchain;
+		pidhead++;
+		queued = 1;
+		pthread_cond_signal(&pidcond);
+	}
+	pthread_mutex_unlock(&pidlock);
+	if (queued)
+		return 0;
+	c->pid = winpid(c->win);
+	return -1;
+}
+
+/* apply a resolved query, swallowing if a terminal is an ancestor */
+void
+pidresolve(Client *c, const PidQuery *q)
+{
+	Client *term;
+	Monitor *m;
+	int pending = c->swallowpending;
+
+	c->pid = q->pid;
+	c->swallowpending = 0;
+	term = q->n ? termforchain(q->chain, q->n) : NULL;
+	if (!term) {
+		if (pending) {
+			mapclient(c);
+			focus(NULL);
+		}
+		return;
+	}
+	m = c->mon;
+	if (pending) /* never laid out, the terminal keeps its place */
+		XMapWindow(dpy, c->win);
+	swallow(term, c);
+	if (pending || m->sel == c) {
+		if (m == selmon)
+			focus(term);
+		else
+			m->sel = term;
+	}
+}
+
+void
+pidresults(int fd, short revents)
+{
+	PidQuery q;
+	Client *c;
+	Monitor *m;
+	uint64_t n;
+
+	if (read(fd, &n, sizeof(n)) < 0 && errno != EAGAIN)
+		return;
+	for (;;) {
+		pthread_mutex_lock(&pidlock);
+		if (pidtail == pidwork) {
+			pthread_mutex_unlock(&pidlock);
+			break;
+		}
+		q = pidq[pidtail++ % LENGTH(pidq)];
+		pthread_mutex_unlock(&pidlock);
+		for (c = NULL, m = mons; m && !c; m = m->next)
+			for (c = m->clients; c && (c->pidseq != q.seq || c->win != q.win); c = c->next);
+		if (c) /* otherwise unmanaged meanwhile */
+			pidresolve(c, &q);
+	}
+	armgrace();
+}
+
+static unsigned long long
+nowms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* schedule gracefd for the earliest pending swallow */
+void
+armgrace(void)
+{
+	struct itimerspec its = {{0}};
+	unsigned long long now = nowms(), due = 0;
+	Client *c;
+	Monitor *m;
+
+	for (m = mons; m; m = m->next)
+		for (c = m->clients; c; c = c->next)
+			if (c->swallowpending) {
+				if (!c->swallowdue)
+					c->swallowdue = now + swallowgrace;
+				if (!due || c->swallowdue < due)
+					due = c->swallowdue;
+			}
+	if (due) { /* a zero it_value would disarm the timer */
+		due = due > now ? due - now : 1;
+		its.it_value.tv_sec = due / 1000;
+		its.it_value.tv_nsec = (due % 1000) * 1000000;
+	}
+	timerfd_settime(gracefd, 0, &its, NULL);
+}
+
+/* show pending clients whose swallow did not resolve in time */
+void
+graceexpired(int fd, short revents)
+{
+	unsigned long long now = nowms();
+	uint64_t n;
+	Client *c;
+	Monitor *m;
+	int shown = 0;
+
+	if (read(fd, &n, sizeof(n)) < 0 && errno != EAGAIN)
+		return;
+	for (m = mons; m; m = m->next)
+		for (c = m->clients; c; c = c->next)
+			if (c->swallowpending && c->swallowdue <= now) {
+				c->swallowpending = 0;
+				mapclient(c);
+				shown = 1;
+			}
+	if (shown)
+		focus(NULL);
+	armgrace();
+}
+
+void
+pidinit(void)
+{
+	proc_init(&proccache, "/proc"); /* filled on the first swallow lookup */
+	if ((pidfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0
+	|| (gracefd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0
+	|| pthread_create(&pidthread, NULL, pidworker, NULL) != 0) {
+		fprintf(stderr, "dwm: cannot start pid worker, swallowing disabled\n");
+		return;
+	}
+	pidrunning = 1;
+	watchfd(pidfd, POLLIN, pidresults);
+	watchfd(gracefd, POLLIN, graceexpired);
+}
+
+void
+pidcleanup(void)
+{
+	if (pidrunning) {
+		pthread_mutex_lock(&pidlock);
+		pidstop = 1;
+		pthread_cond_signal(&pidcond);
+		pthread_mutex_unlock(&pidlock);
+		pthread_join(pidthread, NULL);
+		pidrunning = 0;
+	}
+	if (pidfd >= 0) {
+		unwatchfd(pidfd);
+		close(pidfd);
+	}
+	if (gracefd >= 0) {
+		unwatchfd(gracefd);
+		close(gracefd);
+	}
+	proc_clear(&proccache);
+}
+#else
 Client *
 termforwin(const Client *w)
 {
@@ -3205,6 +4884,7 @@ termforwin(const Client *w)
 
 	return NULL;
 }
+#endif /* __linux__ */
 
 Client *
 swallowingclient(Window w)
@@ -3222,6 +4902,34 @@ swallowingclient(Window w)
 	return NULL;
 }
 
+/**
+ * @brief Multiplex a descriptor into the event loop
+ * @param fd Descriptor to poll alongside the X connection
+ * @param events poll(2) events to wait for
+ * @param func Called from run() with the events that occurred
+ * @return 0 on success, -1 if every slot is taken
+ * @note Registering an fd again replaces its events and handler and
+ *       never fails
+ */
+int
+watchfd(int fd, short events, void (*func)(int fd, short revents))
+{
+	int i;
+
+	for (i = 0; i < nwatches && watches[i].fd != fd; i++);
+	if (i == nwatches) {
+		if (nwatches == LENGTH(watches)) {
+			fprintf(stderr, "dwm: too many watched descriptors\n");
+			return -1;
+		}
+		nwatches++;
+	}
+	watches[i].fd = fd;
+	watches[i].events = events;
+	watches[i].func = func;
+	return 0;
+}
+
 Client *
 wintoclient(Window w)
 {
@@ -3320,6 +5028,9 @@ main(int argc, char *argv[])
 		die("dwm-"VERSION);
 	else if (argc != 1)
 		die("usage: dwm [-v]");
+#ifdef __linux__
+	XInitThreads(); /* pidworker shares the connection through xcb, first Xlib call */
+#endif /* __linux__ */
 	if (!setlocale(LC_CTYPE, "") || !XSupportsLocale())
 		fputs("warning: no locale support\n", stderr);
 	if (!(dpy = XOpenDisplay(NULL)))
@@ -3331,14 +5042,22 @@ main(int argc, char *argv[])
         loadxrdb(); /* added by xrdb patch */
 	setup(); /* initialize everything needed to start dwm */
 #ifdef __OpenBSD__
-	if (pledge("stdio rpath proc exec ps", NULL) == -1)
+	if (pledge("stdio rpath cpath proc exec prot_exec ps unix", NULL) == -1)
 		die("pledge");
 #endif /* __OpenBSD__ */
 	scan(); /* see if other applications are already running */
 	run(); /* main event loop of dwm -->
 * continuously listens to events from the X server (window changes, key presses, mouse) 
 * and sends them to the correct event handler */
-	if(restart) execvp(argv[0], argv);
+	if(restart) {
+		/* with seamlessrestart the bars, pixmaps and cursors outlive the
+		 * connection until the next dwm replaces them */
+		if (seamlessrestart)
+			XSetCloseDownMode(dpy, RetainPermanent);
+		savestate();
+		execvp(argv[0], argv);
+		XSetCloseDownMode(dpy, DestroyAll);
+	}
 	cleanup();
 	XCloseDisplay(dpy);
 	if (restart == 1) {
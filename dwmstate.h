@@ -0,0 +1,112 @@
+/* See LICENSE file for copyright and license details. */
+
+/**
+ * @file dwmstate.h
+ * @brief Layout of the state snapshot dwm publishes in shared memory
+ * @note dwm keeps the monitors and clients in a POSIX shared memory object
+ *       named "/<statename>-<uid>-<display>" (config.h), the display
+ *       number as in $DISPLAY, and rewrites it once the X event queue
+ *       drains, when something changed. Readers map it read-only and copy
+ *       what they need between dwmstate_begin() and dwmstate_retry(), no
+ *       system call or round trip to dwm involved:
+ *
+ *           #include "dwmstate.h"
+ *
+ *           const DwmState *s;
+ *           DwmStateMonitor m;
+ *           unsigned int seq;
+ *           int fd;
+ *
+ *           fd = shm_open("/dwm-state-1000-0", O_RDONLY, 0);
+ *           s = mmap(NULL, sizeof(*s), PROT_READ, MAP_SHARED, fd, 0);
+ *           if (s->magic != DWMSTATE_MAGIC || s->abi != DWMSTATE_ABI)
+ *               ...
+ *           do {
+ *               seq = dwmstate_begin(s);
+ *               m = s->mons[s->selmon % DWMSTATE_MAXMONS];
+ *           } while (dwmstate_retry(s, seq));
+ *
+ *       When live drops to 0 dwm has gone and unlinked the object, a
+ *       restarted dwm publishes into a new one of the same name.
+ *       dwm refuses an object of that name it finds owned by another user
+ *       or open to others; readers should fstat() it for the same reason.
+ */
+
+#include <stdint.h>
+
+#define DWMSTATE_MAGIC      0x736d7764 /* "dwms" on little endian */
+#define DWMSTATE_ABI        1          /* bumped whenever a structure below changes */
+#define DWMSTATE_MAXMONS    16
+#define DWMSTATE_MAXCLIENTS 256
+#define DWMSTATE_TITLESIZE  32768      /* titles past it read as "" */
+
+/* DwmStateClient.flags */
+#define DWMSTATE_FLOATING   (1 << 0)
+#define DWMSTATE_FULLSCREEN (1 << 1)
+#define DWMSTATE_URGENT     (1 << 2)
+#define DWMSTATE_FIXED      (1 << 3) /* min and max size are equal */
+#define DWMSTATE_STICKY     (1 << 4) /* shown on every tag */
+#define DWMSTATE_VISIBLE    (1 << 5) /* on a viewed tag of its monitor */
+#define DWMSTATE_FOCUSED    (1 << 6) /* has the input focus */
+
+typedef struct {
+	int32_t x, y, w, h;     /* screen area */
+	int32_t wx, wy, ww, wh; /* window area, the bar excluded */
+	uint32_t num;           /* Xinerama screen number */
+	uint32_t tags;          /* viewed tags */
+	int32_t sel;            /* selected client, index in clients[], -1 for none */
+	char symbol[16];        /* layout symbol as shown in the bar */
+} DwmStateMonitor;
+
+typedef struct {
+	uint32_t win;           /* X window */
+	uint32_t tags;
+	uint32_t mon;           /* index in mons[] */
+	uint32_t flags;         /* DWMSTATE_* above */
+	int32_t x, y, w, h;     /* geometry, the border excluded */
+	uint32_t title;         /* offset of the NUL terminated title in titles[] */
+} DwmStateClient;
+
+typedef struct {
+	uint32_t magic;         /* DWMSTATE_MAGIC */
+	uint32_t abi;           /* DWMSTATE_ABI dwm was built with */
+	volatile uint32_t seq;  /* odd while dwm writes, see dwmstate_begin() */
+	volatile uint32_t live; /* 0 once dwm has gone */
+	uint32_t ntags;         /* tags in use, bits of the masks below */
+	uint32_t nmons;
+	uint32_t selmon;        /* selected monitor, index in mons[] */
+	uint32_t nclients;      /* clients of mons[0] first, in list order */
+	uint32_t truncated;     /* more than DWMSTATE_MAXCLIENTS clients */
+	DwmStateMonitor mons[DWMSTATE_MAXMONS];
+	DwmStateClient clients[DWMSTATE_MAXCLIENTS];
+	char titles[DWMSTATE_TITLESIZE];
+} DwmState;
+
+/**
+ * @brief Start reading a snapshot
+ * @param s Mapped state
+ * @return Sequence to hand to dwmstate_retry() after the copy
+ */
+static inline uint32_t
+dwmstate_begin(const DwmState *s)
+{
+	uint32_t seq = s->seq;
+
+	__sync_synchronize();
+	return seq;
+}
+
+/**
+ * @brief Check whether what was read since dwmstate_begin() is consistent
+ * @param s Mapped state
+ * @param seq Sequence returned by dwmstate_begin()
+ * @return Non-zero if dwm wrote meanwhile and the copy must be redone
+ * @note Only copies are safe to use, indices and offsets read from s must
+ *       be bounds checked before the retry tells they were consistent
+ */
+static inline int
+dwmstate_retry(const DwmState *s, uint32_t seq)
+{
+	__sync_synchronize();
+	return (seq & 1) || s->seq != seq;
+}
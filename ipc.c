@@ -0,0 +1,456 @@
+/* Commands over a local socket
+ *
+ * Clients such as dwm-msg connect to ipcsock and send one command per line,
+ * named and parsed like the key bindings of rcfile:
+ *
+ *   <command> [arg]                 run a function from commands[], e.g.
+ *                                   "view 3", "setmfact 0.6" or "xrdb"
+ *
+ * Every line is answered with "ok" or "error <reason>", in order, except the
+ * lines of a batch, which are answered by their commit. Commands
+ * run from the event loop like a key press would, the socket never blocks
+ * it: a client that stops reading loses its replies past IPCOUTMAX.
+ *
+ *   begin                           queue the following commands ...
+ *   commit                          ... and run them as one batch: every
+ *                                   monitor is laid out, restacked and has
+ *                                   its bar drawn once, after the last; a
+ *                                   batch with a line that does not parse
+ *                                   is rejected whole
+ *   abort                           drop the queued commands
+ *
+ *   subscribe [event ...]           answer "ok", then the current state and
+ *                                   every change of the named events, all
+ *                                   of them if none are named
+ *
+ * Events, one per line, windows in hex:
+ *
+ *   tags <mon> <view> <occupied> <urgent>   tag masks of a monitor
+ *   layout <mon> <symbol>                   layout symbol of a monitor
+ *   monitor <mon>                           the selected monitor
+ *   focus <mon> <win>                       the focused window, 0x0 for none
+ *   title <win> <title>                     a window's new title
+ *   urgent <win>                            a window asking for attention
+ *
+ * dwm.c reports changes with ipcevent(); they are written once the X queue
+ * drains, one line per monitor or window however often it changed, and
+ * monitor and focus lines only if they differ from the last ones sent. A
+ * subscriber too slow to take a line loses it, but gets the current state
+ * of that event once its queue has drained, so it never falls behind more
+ * than IPCOUTMAX and never stalls dwm.
+ */
+
+#define MAXIPCCONNS 16
+#define IPCOUTMAX   4096 /* unread replies and events kept per client */
+#define MAXIPCMONS  8    /* monitors whose last lines are remembered */
+#define MAXIPCWINS  32   /* windows with pending title and urgent events */
+#define IPCBATCHMAX 64   /* commands in one batch at most */
+
+enum { EvTags, EvLayout, EvMonitor, EvFocus, EvTitle, EvUrgent, EvLast }; /* events */
+
+static const char *evnames[] = {
+	[EvTags] = "tags", [EvLayout] = "layout", [EvMonitor] = "monitor",
+	[EvFocus] = "focus", [EvTitle] = "title", [EvUrgent] = "urgent",
+};
+
+static void ipcaccept(int fd, short revents);
+static void ipccommit(Conn *c, char *batch);
+static void ipcconn(int fd, short revents);
+static void ipcdrop(Conn *c);
+static void ipcevent(int ev, Window w);
+static void ipcflush(void);
+static void ipcinit(void);
+static void ipcline(Conn *c, char *line);
+static void ipcquit(void);
+static void ipcreply(Conn *c, const char *fmt, ...);
+static void ipcsend(int ev, int only, const char *fmt, ...);
+static void ipcstate(unsigned int evs, int only);
+static void ipcsubscribe(unsigned int i, char *line);
+
+static int ipcfd = -1;
+static char ipcpath[108];
+static Conn *ipcconns[MAXIPCCONNS];
+static unsigned int ipcsubs[MAXIPCCONNS]; /* events each client subscribed to */
+static unsigned int ipclost[MAXIPCCONNS]; /* events it missed, resent when drained */
+static unsigned int nipcsubs;
+static char *ipcbatch[MAXIPCCONNS];       /* lines queued since begin */
+static size_t ipcbatchlen[MAXIPCCONNS];
+static unsigned int ipcbatchn[MAXIPCCONNS];
+static unsigned int evpending;            /* events changed since ipcflush() */
+static Window evwins[EvLast][MAXIPCWINS]; /* windows of pending title and urgent */
+static unsigned int nevwins[EvLast];      /* past MAXIPCWINS every window is sent */
+static char evsent[MAXIPCMONS][EvLast][64]; /* last tags and layout lines per monitor */
+static char evsentsel[EvLast][64];          /* last monitor and focus lines */
+
+void
+ipcreply(Conn *c, const char *fmt, ...)
+{
+	char buf[256];
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(buf, sizeof(buf) - 1, fmt, ap);
+	va_end(ap);
+	if (n < 0)
+		return;
+	n = MIN(n, (int)sizeof(buf) - 2);
+	buf[n++] = '\n';
+	conn_write(c, buf, n);
+}
+
+void
+ipcline(Conn *c, char *line)
+{
+	const Command *cmd;
+	unsigned int i;
+	char *name, *p;
+	size_t len;
+	Arg arg;
+
+	if (!(name = rcword(&line)))
+		return; /* blank lines and comments are not answered */
+	for (i = 0; i < MAXIPCCONNS && ipcconns[i] != c; i++);
+	if (!strcmp(name, "subscribe")) {
+		ipcsubscribe(i, line);
+		return;
+	}
+	if (!strcmp(name, "begin")) {
+		if (ipcbatch[i])
+			ipcreply(c, "error batch already begun");
+		else {
+			ipcbatch[i] = ecalloc(1, 1);
+			ipcreply(c, "ok");
+		}
+		return;
+	}
+	if (ipcbatch[i] && (!strcmp(name, "commit") || !strcmp(name, "abort"))) {
+		if (name[0] == 'c' && ipcbatchn[i] > IPCBATCHMAX)
+			ipcreply(c, "error batch longer than %d commands", IPCBATCHMAX);
+		else if (name[0] == 'c')
+			ipccommit(c, ipcbatch[i]);
+		else
+			ipcreply(c, "ok");
+		free(ipcbatch[i]);
+		ipcbatch[i] = NULL;
+		ipcbatchlen[i] = ipcbatchn[i] = 0;
+		return;
+	}
+	if (ipcbatch[i]) { /* queued, "name rest" */
+		if (ipcbatchn[i]++ < IPCBATCHMAX) {
+			len = strlen(name) + 1 + strlen(line) + 1;
+			if (!(p = realloc(ipcbatch[i], ipcbatchlen[i] + len + 1)))
+				die("realloc:");
+			ipcbatch[i] = p;
+			ipcbatchlen[i] += sprintf(p + ipcbatchlen[i], "%s %s\n", name, line);
+		}
+		return;
+	}
+	if (!(cmd = findcommand(name))) {
+		ipcreply(c, "error unknown command %s", name);
+		return;
+	}
+	if (cmdarg(cmd, line, &arg) < 0) {
+		ipcreply(c, "error bad argument for %s", name);
+		return;
+	}
+	cmd->func(&arg);
+	if (cmd->argtype == ArgCmd || cmd->argtype == ArgScratch)
+		free((void *)arg.v);
+	ipcreply(c, "ok");
+}
+
+/* parse every queued line first, then run them with arrange held */
+void
+ipccommit(Conn *c, char *batch)
+{
+	const Command *cmds[IPCBATCHMAX];
+	Arg args[IPCBATCHMAX];
+	unsigned int i, n = 0, lineno = 0;
+	char *line, *nl, *name;
+	int err = 0;
+
+	/* ipcline() queues IPCBATCHMAX lines at most */
+	for (line = batch; !err && (nl = strchr(line, '\n')); line = nl + 1) {
+		*nl = '\0';
+		lineno++;
+		name = rcword(&line);
+		if (!(cmds[n] = findcommand(name))) {
+			ipcreply(c, "error line %u: unknown command %s", lineno, name);
+			err = 1;
+		} else if (cmdarg(cmds[n], line, &args[n]) < 0) {
+			ipcreply(c, "error line %u: bad argument for %s", lineno, name);
+			err = 1;
+		} else
+			n++;
+	}
+	if (!err) {
+		holdarrange();
+		for (i = 0; i < n; i++)
+			cmds[i]->func(&args[i]);
+		releasearrange();
+		ipcreply(c, "ok");
+	}
+	for (i = 0; i < n; i++)
+		if (cmds[i]->argtype == ArgCmd || cmds[i]->argtype == ArgScratch)
+			free((void *)args[i].v);
+}
+
+void
+ipcsubscribe(unsigned int i, char *line)
+{
+	unsigned int evs = 0, ev;
+	char *w;
+
+	while ((w = rcword(&line))) {
+		for (ev = 0; ev < EvLast && strcmp(evnames[ev], w); ev++);
+		if (ev == EvLast) {
+			ipcreply(ipcconns[i], "error unknown event %s", w);
+			return;
+		}
+		evs |= 1 << ev;
+	}
+	if (!ipcsubs[i] && !nipcsubs++) {
+		/* nothing was tracked while no one listened, so the last lines
+		 * sent say nothing about what changes now */
+		memset(evsent, 0, sizeof(evsent));
+		memset(evsentsel, 0, sizeof(evsentsel));
+	}
+	ipcsubs[i] = evs ? evs : (1 << EvLast) - 1;
+	ipcreply(ipcconns[i], "ok");
+	ipcstate(ipcsubs[i], i);
+}
+
+/* write a line of event ev to its subscribers, or only to subscriber only
+ * if it is not -1 */
+void
+ipcsend(int ev, int only, const char *fmt, ...)
+{
+	char buf[512];
+	va_list ap;
+	unsigned int i;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(buf, sizeof(buf) - 1, fmt, ap);
+	va_end(ap);
+	if (n < 0)
+		return;
+	n = MIN(n, (int)sizeof(buf) - 2);
+	buf[n++] = '\n';
+	for (i = 0; i < MAXIPCCONNS; i++) {
+		if (!(ipcsubs[i] & 1 << ev) || (only >= 0 && (int)i != only) || ipclost[i] & 1 << ev)
+			continue;
+		if (conn_write(ipcconns[i], buf, n) < 0)
+			ipclost[i] |= 1 << ev;
+		if (ipcconns[i]->outlen)
+			watchfd(ipcconns[i]->fd, POLLIN | POLLOUT, ipcconn);
+	}
+}
+
+/* the current state of evs, for a new or caught up subscriber */
+void
+ipcstate(unsigned int evs, int only)
+{
+	unsigned int occ, urg;
+	Monitor *m;
+	Client *c;
+
+	for (m = mons; m; m = m->next) {
+		if (evs & 1 << EvTags) {
+			for (occ = urg = 0, c = m->clients; c; c = c->next) {
+				occ |= c->tags;
+				if (c->isurgent)
+					urg |= c->tags;
+			}
+			ipcsend(EvTags, only, "tags %d %u %u %u", m->num, m->tagset[m->seltags], occ, urg);
+		}
+		if (evs & 1 << EvLayout)
+			ipcsend(EvLayout, only, "layout %d %s", m->num, m->ltsymbol);
+		if (evs & 1 << EvUrgent)
+			for (c = m->clients; c; c = c->next)
+				if (c->isurgent)
+					ipcsend(EvUrgent, only, "urgent 0x%lx", c->win);
+	}
+	if (evs & 1 << EvMonitor)
+		ipcsend(EvMonitor, only, "monitor %d", selmon->num);
+	if (evs & 1 << EvFocus)
+		ipcsend(EvFocus, only, "focus %d 0x%lx", selmon->num, selmon->sel ? selmon->sel->win : 0);
+	if (evs & 1 << EvTitle && selmon->sel)
+		ipcsend(EvTitle, only, "title 0x%lx %s", selmon->sel->win, selmon->sel->name);
+}
+
+/**
+ * @brief Note a change for the subscribers
+ * @param ev Event that changed
+ * @param w Window of a title or urgent event, None otherwise
+ * @note Nothing is written until ipcflush(); costs nothing without
+ *       subscribers
+ */
+void
+ipcevent(int ev, Window w)
+{
+	unsigned int i;
+
+	if (!nipcsubs)
+		return;
+	evpending |= 1 << ev;
+	if (!w || nevwins[ev] > MAXIPCWINS)
+		return;
+	for (i = 0; i < nevwins[ev] && evwins[ev][i] != w; i++);
+	if (i == nevwins[ev]) {
+		if (i < MAXIPCWINS)
+			evwins[ev][i] = w;
+		nevwins[ev]++;
+	}
+}
+
+/* write the events that changed since the last call, once per monitor or
+ * window; called when the X queue drains */
+void
+ipcflush(void)
+{
+	char line[EvLast][64], *sent;
+	unsigned int i, occ, urg, ev;
+	Monitor *m;
+	Client *c;
+
+	if (!evpending)
+		return;
+	for (m = mons; m; m = m->next) {
+		for (occ = urg = 0, c = m->clients; c; c = c->next) {
+			occ |= c->tags;
+			if (c->isurgent)
+				urg |= c->tags;
+		}
+		snprintf(line[EvTags], sizeof(line[EvTags]), "tags %d %u %u %u",
+			m->num, m->tagset[m->seltags], occ, urg);
+		snprintf(line[EvLayout], sizeof(line[EvLayout]), "layout %d %s", m->num, m->ltsymbol);
+		snprintf(line[EvMonitor], sizeof(line[EvMonitor]), "monitor %d", selmon->num);
+		snprintf(line[EvFocus], sizeof(line[EvFocus]), "focus %d 0x%lx",
+			selmon->num, selmon->sel ? selmon->sel->win : 0);
+		for (ev = 0; ev <= EvFocus; ev++) {
+			if (!(evpending & 1 << ev) || (ev >= EvMonitor && m != selmon))
+				continue;
+			if (ev >= EvMonitor)
+				sent = evsentsel[ev];
+			else
+				sent = m->num >= 0 && m->num < MAXIPCMONS ? evsent[m->num][ev] : NULL;
+			if (sent) {
+				if (!strcmp(sent, line[ev]))
+					continue;
+				strcpy(sent, line[ev]);
+			}
+			ipcsend(ev, -1, "%s", line[ev]);
+		}
+	}
+	for (ev = EvTitle; ev <= EvUrgent; ev++) {
+		if (!(evpending & 1 << ev))
+			continue;
+		for (m = mons; m; m = m->next)
+			for (c = m->clients; c; c = c->next) {
+				for (i = 0; i < nevwins[ev] && i < MAXIPCWINS && evwins[ev][i] != c->win; i++);
+				if (nevwins[ev] <= MAXIPCWINS && i == nevwins[ev])
+					continue;
+				if (ev == EvTitle)
+					ipcsend(ev, -1, "title 0x%lx %s", c->win, c->name);
+				else if (c->isurgent)
+					ipcsend(ev, -1, "urgent 0x%lx", c->win);
+			}
+		nevwins[ev] = 0;
+	}
+	evpending = 0;
+}
+
+void
+ipcdrop(Conn *c)
+{
+	unsigned int i;
+
+	for (i = 0; i < MAXIPCCONNS; i++)
+		if (ipcconns[i] == c) {
+			ipcconns[i] = NULL;
+			if (ipcsubs[i])
+				nipcsubs--;
+			ipcsubs[i] = ipclost[i] = 0;
+			free(ipcbatch[i]); /* a batch without commit is dropped */
+			ipcbatch[i] = NULL;
+			ipcbatchlen[i] = ipcbatchn[i] = 0;
+		}
+	unwatchfd(c->fd);
+	conn_free(c);
+}
+
+void
+ipcconn(int fd, short revents)
+{
+	Conn *c = NULL;
+	unsigned int i, lost;
+
+	for (i = 0; i < MAXIPCCONNS && !c; i++)
+		if (ipcconns[i] && ipcconns[i]->fd == fd)
+			c = ipcconns[i];
+	if (!c)
+		return;
+	i--;
+	if (((revents & POLLOUT) && conn_flush(c) < 0)
+	|| ((revents & (POLLIN | POLLHUP | POLLERR)) && conn_read(c, ipcline) < 0)) {
+		/* a client that sent its commands and shut down its side still
+		 * gets the replies that fit into the socket */
+		conn_flush(c);
+		ipcdrop(c);
+		return;
+	}
+	if (!c->outlen && ipclost[i]) { /* caught up, send what it missed */
+		lost = ipclost[i];
+		ipclost[i] = 0;
+		ipcstate(lost, i);
+	}
+	watchfd(fd, POLLIN | (c->outlen ? POLLOUT : 0), ipcconn);
+}
+
+void
+ipcaccept(int fd, short revents)
+{
+	Conn *c;
+	unsigned int i;
+
+	while ((c = conn_accept(fd, IPCOUTMAX))) {
+		for (i = 0; i < MAXIPCCONNS && ipcconns[i]; i++);
+		if (i == MAXIPCCONNS || watchfd(c->fd, POLLIN, ipcconn) < 0) {
+			conn_free(c);
+			continue;
+		}
+		ipcconns[i] = c;
+	}
+}
+
+void
+ipcinit(void)
+{
+	if (!ipcsock)
+		return;
+	if (sock_path(ipcpath, sizeof(ipcpath), ipcsock) < 0
+	|| (ipcfd = sock_listen(ipcpath)) < 0) {
+		fprintf(stderr, "dwm: cannot listen on command socket '%s'\n", ipcsock);
+		ipcpath[0] = '\0';
+		return;
+	}
+	watchfd(ipcfd, POLLIN, ipcaccept);
+}
+
+void
+ipcquit(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < MAXIPCCONNS; i++)
+		if (ipcconns[i])
+			ipcdrop(ipcconns[i]);
+	if (ipcfd < 0)
+		return;
+	unwatchfd(ipcfd);
+	close(ipcfd);
+	unlink(ipcpath);
+	ipcfd = -1;
+}
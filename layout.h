@@ -0,0 +1,68 @@
+/* See LICENSE file for copyright and license details. */
+
+/**
+ * @file layout.h
+ * @brief Interface between dwm and layout plugins
+ * @note A plugin is a shared object exporting one LayoutPlugin named
+ *       dwmlayout. dwm loads every *.so in layoutdir (config.h) at startup
+ *       and again on reloadlayouts; an object whose abi differs from
+ *       LAYOUT_ABI is skipped. Plugins only compute geometry, they never
+ *       see X or dwm's own structures:
+ *
+ *           #include "layout.h"
+ *
+ *           static void
+ *           columns(const LayoutParams *p, LayoutRect *r)
+ *           {
+ *               unsigned int i;
+ *               int w = (p->area.w - 2 * p->gappov - (p->n - 1) * p->gappiv) / p->n;
+ *
+ *               for (i = 0; i < p->n; i++)
+ *                   r[i] = (LayoutRect){ p->area.x + p->gappov + i * (w + p->gappiv),
+ *                       p->area.y + p->gappoh, w, p->area.h - 2 * p->gappoh };
+ *           }
+ *
+ *           const LayoutPlugin dwmlayout = { LAYOUT_ABI, "|||", columns };
+ *
+ *       built with cc -shared -fPIC -o columns.so columns.c
+ */
+
+#define LAYOUT_ABI 1 /* bumped whenever a structure below changes */
+
+typedef struct {
+	int x, y, w, h;
+} LayoutRect;
+
+/** @brief A tiled client as the layout sees it, sizes exclude the border */
+typedef struct {
+	int basew, baseh, incw, inch;
+	int maxw, maxh, minw, minh;
+	float mina, maxa;   /* aspect ratio limits, 0 if unset */
+	int bw;             /* border width */
+	int isfixed;        /* min and max size are equal */
+} LayoutClient;
+
+/** @brief Everything a layout may place windows by */
+typedef struct {
+	LayoutRect area;    /* monitor work area, the bar excluded */
+	int gappoh, gappov; /* outer gaps, horizontal and vertical, 0 if disabled */
+	int gappih, gappiv; /* inner gaps, horizontal and vertical, 0 if disabled */
+	float mfact;        /* master area factor [0.05..0.95] */
+	int nmaster;        /* number of clients in the master area */
+	unsigned int n;     /* number of clients, at least 1 */
+	const LayoutClient *clients; /* tiled clients in stacking order */
+} LayoutParams;
+
+typedef struct {
+	unsigned int abi;   /* LAYOUT_ABI the plugin was built against */
+	const char *symbol; /* shown in the bar, at most 15 bytes */
+	/**
+	 * @brief Place the tiled clients of a monitor
+	 * @param p Work area, gaps and clients
+	 * @param r Receives one outer rectangle, border included, per client;
+	 *        holds the current geometry on entry, so entries left alone
+	 *        keep their place
+	 * @note dwm applies size hints afterwards when resizehints is set
+	 */
+	void (*arrange)(const LayoutParams *p, LayoutRect *r);
+} LayoutPlugin;
@@ -0,0 +1,119 @@
+/* See LICENSE file for copyright and license details. */
+#include <stdlib.h>
+#include <string.h>
+
+#include "match.h"
+#include "util.h"
+
+static void *
+grow(void *p, size_t size)
+{
+	if (!(p = realloc(p, size)))
+		die("realloc:");
+	return p;
+}
+
+static int
+newstate(Matcher *m)
+{
+	int s;
+
+	if (m->nstates == m->size) {
+		m->size = m->size ? m->size * 2 : 16;
+		m->go = grow(m->go, m->size * sizeof(*m->go));
+		m->fail = grow(m->fail, m->size * sizeof(int));
+		m->dict = grow(m->dict, m->size * sizeof(int));
+		m->first = grow(m->first, m->size * sizeof(int));
+	}
+	s = m->nstates++;
+	memset(m->go[s], -1, sizeof(m->go[s]));
+	m->fail[s] = m->dict[s] = 0;
+	m->first[s] = -1;
+	return s;
+}
+
+void
+match_init(Matcher *m)
+{
+	memset(m, 0, sizeof(*m));
+	newstate(m);
+}
+
+void
+match_add(Matcher *m, const char *pat, int id)
+{
+	const unsigned char *p;
+	int s = 0, t;
+
+	for (p = (const unsigned char *)pat; *p; p++) {
+		if (m->go[s][*p] < 0) {
+			t = newstate(m); /* may move go */
+			m->go[s][*p] = t;
+		}
+		s = m->go[s][*p];
+	}
+	if (id >= m->nids) {
+		m->pnext = grow(m->pnext, (id + 1) * sizeof(int));
+		memset(m->pnext + m->nids, -1, (id + 1 - m->nids) * sizeof(int));
+		m->nids = id + 1;
+	}
+	m->pnext[id] = m->first[s];
+	m->first[s] = id;
+}
+
+void
+match_build(Matcher *m)
+{
+	int *queue, head = 0, tail = 0, s, t, c;
+
+	queue = ecalloc(m->nstates, sizeof(int));
+	for (c = 0; c < 256; c++) {
+		if ((t = m->go[0][c]) < 0)
+			m->go[0][c] = 0;
+		else
+			queue[tail++] = t;
+	}
+	/* breadth first, so a state's fail target is finished before it */
+	while (head < tail) {
+		s = queue[head++];
+		for (c = 0; c < 256; c++) {
+			if ((t = m->go[s][c]) < 0) {
+				m->go[s][c] = m->go[m->fail[s]][c];
+				continue;
+			}
+			m->fail[t] = m->go[m->fail[s]][c];
+			/* the root's patterns are empty and reported up front */
+			m->dict[t] = m->fail[t] && m->first[m->fail[t]] >= 0
+			           ? m->fail[t] : m->dict[m->fail[t]];
+			queue[tail++] = t;
+		}
+	}
+	free(queue);
+}
+
+void
+match_run(const Matcher *m, const char *s, unsigned char *hit)
+{
+	const unsigned char *p;
+	int st = 0, t, id;
+
+	for (id = m->first[0]; id >= 0; id = m->pnext[id])
+		hit[id] = 1;
+	for (p = (const unsigned char *)s; *p; p++) {
+		st = m->go[st][*p];
+		for (t = m->first[st] >= 0 ? st : m->dict[st]; t; t = m->dict[t])
+			for (id = m->first[t]; id >= 0; id = m->pnext[id])
+				hit[id] = 1;
+	}
+}
+
+void
+match_free(Matcher *m)
+{
+	free(m->go);
+	free(m->fail);
+	free(m->dict);
+	free(m->first);
+	free(m->pnext);
+	memset(m, 0, sizeof(*m));
+}
@@ -0,0 +1,57 @@
+/* See LICENSE file for copyright and license details. */
+
+/**
+ * @file match.h
+ * @brief Multi-pattern substring matcher (Aho-Corasick) for window rules
+ */
+
+/**
+ * @brief Set of patterns compiled into one automaton, so a text is
+ *        searched for all of them in a single pass
+ */
+typedef struct {
+	int (*go)[256];           /* transitions, -1 in the trie, complete once built */
+	int *fail;                /* longest proper suffix that is a trie state */
+	int *dict;                /* nearest suffix state ending a pattern, 0 if none */
+	int *first;               /* first pattern ending at the state, -1 if none */
+	int *pnext;               /* next pattern ending at the same state, by id */
+	int nstates, size, nids;
+} Matcher;
+
+/**
+ * @brief Set up an empty matcher
+ * @param m Matcher to initialize
+ */
+void match_init(Matcher *m);
+
+/**
+ * @brief Add a pattern
+ * @param m Matcher, not built yet
+ * @param pat Pattern, matched case-sensitively like strstr()
+ * @param id Caller's id for the pattern, a small non-negative number;
+ *        several patterns may share one and equal patterns may be added
+ *        under different ids
+ */
+void match_add(Matcher *m, const char *pat, int id);
+
+/**
+ * @brief Finish the automaton after the last match_add()
+ * @param m Matcher to build
+ */
+void match_build(Matcher *m);
+
+/**
+ * @brief Find which patterns occur in a text
+ * @param m Built matcher
+ * @param s Text to search
+ * @param hit Set to 1 at the id of every pattern that occurs in s, left
+ *        alone otherwise; must hold every id that was added
+ * @note Linear in the length of s plus the number of occurrences
+ */
+void match_run(const Matcher *m, const char *s, unsigned char *hit);
+
+/**
+ * @brief Free the matcher's tables
+ * @param m Matcher to clear, usable again after match_init()
+ */
+void match_free(Matcher *m);
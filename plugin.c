@@ -0,0 +1,210 @@
+/* Layout plugins
+ *
+ * Every *.so in layoutdir, relative to $XDG_CONFIG_HOME (or ~/.config), that
+ * exports a LayoutPlugin named dwmlayout (see layout.h) gets a slot after
+ * layouts[] in the layout cycle. Slots never move, so Monitor.lt[] and key
+ * arguments may point at them; reloadlayouts reopens each object in place
+ * and arranges once. Objects should be replaced by a rename (install(1),
+ * mv), writing into a loaded one crashes dwm.
+ */
+
+#define MAXPLUGINS 32
+
+typedef struct {
+	Layout lt;                /* first, Monitor.lt[] points here */
+	char symbol[16];          /* lt.symbol, outlives the object */
+	char name[256];           /* file name in layoutdir */
+	void *handle;
+	const LayoutPlugin *p;    /* NULL while the object is missing or broken */
+} Plugin;
+
+static const Layout *layoutat(int i);
+static int layoutindex(const Layout *l);
+static void loadplugins(void);
+static int openplugin(Plugin *pl);
+static void pluginarrange(Monitor *m);
+static void plugininit(void);
+static void unloadplugins(void);
+
+static Plugin plugins[MAXPLUGINS];
+static unsigned int nplugins;
+static char plugindir[4096];
+
+/* layouts[] and then the loaded plugins, NULL past the end or for a gap */
+const Layout *
+layoutat(int i)
+{
+	if (i < 0)
+		return NULL;
+	if (i < (int)LENGTH(layouts))
+		return &layouts[i];
+	i -= LENGTH(layouts);
+	return i < (int)nplugins && plugins[i].p ? &plugins[i].lt : NULL;
+}
+
+int
+layoutindex(const Layout *l)
+{
+	if (l >= layouts && l < layouts + LENGTH(layouts))
+		return l - layouts;
+	return LENGTH(layouts) + ((const Plugin *)l - plugins);
+}
+
+/* dlopen pl->name, 0 if it exports a dwmlayout of our ABI */
+int
+openplugin(Plugin *pl)
+{
+	char path[4096 + 256];
+	const LayoutPlugin *p;
+
+	if (pl->handle)
+		dlclose(pl->handle);
+	pl->handle = NULL;
+	pl->p = NULL;
+	snprintf(path, sizeof(path), "%s/%s", plugindir, pl->name);
+	if (!(pl->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL))) {
+		fprintf(stderr, "dwm: %s\n", dlerror());
+		return -1;
+	}
+	p = dlsym(pl->handle, "dwmlayout");
+	if (!p || p->abi != LAYOUT_ABI || !p->arrange) {
+		fprintf(stderr, "dwm: %s: no dwmlayout for ABI %d\n", path, LAYOUT_ABI);
+		dlclose(pl->handle);
+		pl->handle = NULL;
+		return -1;
+	}
+	pl->p = p;
+	snprintf(pl->symbol, sizeof(pl->symbol), "%s", p->symbol ? p->symbol : "?");
+	pl->lt.symbol = pl->symbol;
+	pl->lt.arrange = pluginarrange;
+	return 0;
+}
+
+/* (re)open every object in plugindir, new names get new slots */
+void
+loadplugins(void)
+{
+	unsigned char seen[MAXPLUGINS] = { 0 };
+	struct dirent **de;
+	unsigned int i;
+	size_t len;
+	int n, j;
+
+	if ((n = scandir(plugindir, &de, NULL, alphasort)) < 0)
+		n = 0;
+	for (j = 0; j < n; j++) {
+		len = strlen(de[j]->d_name);
+		if (len > 3 && len < sizeof(plugins->name) && !strcmp(de[j]->d_name + len - 3, ".so")) {
+			for (i = 0; i < nplugins && strcmp(plugins[i].name, de[j]->d_name); i++);
+			if (i == nplugins && nplugins < MAXPLUGINS)
+				strcpy(plugins[nplugins++].name, de[j]->d_name);
+			if (i < nplugins) {
+				seen[i] = 1;
+				openplugin(&plugins[i]);
+			}
+		}
+		free(de[j]);
+	}
+	if (n > 0)
+		free(de);
+	for (i = 0; i < nplugins; i++)
+		if (!seen[i] && plugins[i].handle) {
+			dlclose(plugins[i].handle);
+			plugins[i].handle = NULL;
+			plugins[i].p = NULL;
+		}
+}
+
+void
+plugininit(void)
+{
+	if (layoutdir && configpath(plugindir, sizeof(plugindir), layoutdir) == 0)
+		loadplugins();
+}
+
+void
+unloadplugins(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < nplugins; i++)
+		if (plugins[i].handle)
+			dlclose(plugins[i].handle);
+	nplugins = 0;
+}
+
+/* arrange function of every plugin slot, see layout.h */
+void
+pluginarrange(Monitor *m)
+{
+	static LayoutClient *lc;
+	static LayoutRect *r;
+	static unsigned int size;
+	const Plugin *pl = (const Plugin *)m->lt[m->sellt];
+	LayoutParams p;
+	unsigned int i, n;
+	int oh, ov, ih, iv;
+	Client *c;
+
+	getgaps(m, &oh, &ov, &ih, &iv, &n);
+	if (!n || !pl->p)
+		return;
+	if (n > size) {
+		size = n * 2;
+		free(lc);
+		free(r);
+		lc = ecalloc(size, sizeof(LayoutClient));
+		r = ecalloc(size, sizeof(LayoutRect));
+	}
+	for (i = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++) {
+		lc[i] = (LayoutClient){ c->basew, c->baseh, c->incw, c->inch,
+			c->maxw, c->maxh, c->minw, c->minh, c->mina, c->maxa, c->bw, c->isfixed };
+		r[i] = (LayoutRect){ c->x, c->y, WIDTH(c), HEIGHT(c) };
+	}
+	p = (LayoutParams){ { m->wx, m->wy, m->ww, m->wh }, oh, ov, ih, iv,
+		m->mfact, m->nmaster, n, lc };
+	pl->p->arrange(&p, r);
+	for (i = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), i++)
+		resize(c, r[i].x, r[i].y, r[i].w - 2 * c->bw, r[i].h - 2 * c->bw, 0);
+}
+
+/**
+ * @brief Step through layouts[] and the loaded plugins
+ * @param arg arg->i is the step, +1 for the next layout
+ */
+void
+cyclelayout(const Arg *arg)
+{
+	int i, n = LENGTH(layouts) + nplugins, step = arg->i ? arg->i : 1;
+	const Layout *l;
+
+	i = layoutindex(selmon->lt[selmon->sellt]);
+	do
+		i = ((i + step) % n + n) % n;
+	while (!(l = layoutat(i)));
+	setlayout(&(Arg){ .v = l });
+}
+
+/**
+ * @brief Reopen the layout plugins and arrange once
+ * @note Monitors on a plugin that is gone fall back to the first layout,
+ *       the bar shows the symbol of whatever layout is current afterwards
+ */
+void
+reloadlayouts(const Arg *arg)
+{
+	Monitor *m;
+
+	if (!layoutdir || !plugindir[0])
+		return;
+	loadplugins();
+	for (m = mons; m; m = m->next) {
+		if (!layoutat(layoutindex(m->lt[0])))
+			m->lt[0] = &layouts[0];
+		if (!layoutat(layoutindex(m->lt[1])))
+			m->lt[1] = &layouts[0];
+		strncpy(m->ltsymbol, m->lt[m->sellt]->symbol, sizeof m->ltsymbol);
+	}
+	arrange(NULL);
+	drawbars();
+}
@@ -0,0 +1,189 @@
+/* See LICENSE file for copyright and license details. */
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "proc.h"
+#include "util.h"
+
+#define PROC_MINSIZE 1024
+
+static unsigned long long
+proc_now(void)
+{
+#ifdef CLOCK_BOOTTIME
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_BOOTTIME, &ts) == 0)
+		return (unsigned long long)ts.tv_sec * sysconf(_SC_CLK_TCK)
+		       + (unsigned long long)ts.tv_nsec * sysconf(_SC_CLK_TCK) / 1000000000;
+#endif
+	return 0; /* nothing cached is ever trusted */
+}
+
+/* read ppid and start time (fields 4 and 22) of <root>/<pid>/stat */
+static int
+proc_readstat(ProcCache *pc, pid_t pid, pid_t *ppid, unsigned long long *start)
+{
+	char path[96], buf[1024], *s;
+	ssize_t n;
+	int fd, i;
+
+	snprintf(path, sizeof(path), "%s/%d/stat", pc->root, (int)pid);
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		return -1;
+	n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (n <= 0)
+		return -1;
+	buf[n] = '\0';
+	/* comm may contain spaces and parentheses, the last ')' ends it */
+	if (!(s = strrchr(buf, ')')) || s[1] != ' ')
+		return -1;
+	for (s += 2, i = 3; i < 22; i++) {
+		if (i == 4)
+			*ppid = (pid_t)strtol(s, NULL, 10);
+		if (!(s = strchr(s, ' ')))
+			return -1;
+		s++;
+	}
+	*start = strtoull(s, NULL, 10);
+	return 0;
+}
+
+static ProcEntry *
+proc_slot(ProcCache *pc, pid_t pid)
+{
+	unsigned int i = ((unsigned int)pid * 2654435761u) & (pc->size - 1);
+
+	while (pc->tab[i].pid && pc->tab[i].pid != pid)
+		i = (i + 1) & (pc->size - 1);
+	return &pc->tab[i];
+}
+
+static void proc_scan(ProcCache *pc);
+
+static ProcEntry *
+proc_put(ProcCache *pc, pid_t pid, pid_t ppid, unsigned long long start, unsigned long long seen)
+{
+	ProcEntry *e;
+
+	if (!pc->tab)
+		proc_scan(pc);
+	e = proc_slot(pc, pid);
+	if (!e->pid) {
+		if ((pc->count + 1) * 2 > pc->size) {
+			proc_scan(pc); /* drops exited processes, grows if still full */
+			e = proc_slot(pc, pid);
+		}
+		if (!e->pid)
+			pc->count++;
+	}
+	e->pid = pid;
+	e->ppid = ppid;
+	e->start = start;
+	e->seen = seen;
+	return e;
+}
+
+/* rebuild the table from every pid under the proc root */
+void
+proc_scan(ProcCache *pc)
+{
+	struct dirent *de;
+	unsigned long long start, seen;
+	unsigned int n = 0;
+	pid_t pid, ppid;
+	DIR *d;
+
+	pc->scans++;
+	free(pc->tab);
+	pc->size = MAX(pc->size, PROC_MINSIZE);
+	if ((d = opendir(pc->root))) {
+		while ((de = readdir(d)))
+			if (isdigit((unsigned char)de->d_name[0]))
+				n++;
+		while (n * 2 > pc->size)
+			pc->size *= 2;
+		rewinddir(d);
+	}
+	pc->tab = ecalloc(pc->size, sizeof(ProcEntry));
+	pc->count = 0;
+	if (!d)
+		return;
+	seen = proc_now();
+	while ((de = readdir(d))) {
+		if (!isdigit((unsigned char)de->d_name[0]) || pc->count * 2 >= pc->size)
+			continue;
+		pid = (pid_t)strtol(de->d_name, NULL, 10);
+		if (pid > 0 && proc_readstat(pc, pid, &ppid, &start) == 0) {
+			*proc_slot(pc, pid) = (ProcEntry){ pid, ppid, start, seen };
+			pc->count++;
+		}
+	}
+	closedir(d);
+}
+
+void
+proc_init(ProcCache *pc, const char *root)
+{
+	memset(pc, 0, sizeof(*pc));
+	snprintf(pc->root, sizeof(pc->root), "%s", root);
+}
+
+void
+proc_clear(ProcCache *pc)
+{
+	free(pc->tab);
+	pc->tab = NULL;
+	pc->size = pc->count = 0;
+}
+
+static ProcEntry *
+proc_read(ProcCache *pc, pid_t pid)
+{
+	unsigned long long start, seen = proc_now();
+	pid_t ppid;
+
+	pc->reads++;
+	if (proc_readstat(pc, pid, &ppid, &start) < 0)
+		return NULL;
+	return proc_put(pc, pid, ppid, start, seen);
+}
+
+int
+proc_ancestors(ProcCache *pc, pid_t pid, pid_t *chain, int max)
+{
+	ProcEntry *e;
+	unsigned long long start;
+	pid_t ppid;
+	int n = 0;
+
+	if (pid <= 0 || max <= 0 || !(e = proc_read(pc, pid)))
+		return 0;
+	chain[n++] = pid;
+	while (n < max && (ppid = e->ppid) > 0) {
+		start = e->start;
+		/* a parent read before the child started may be an earlier
+		 * process that had the same pid */
+		e = proc_slot(pc, ppid);
+		if (e->pid && e->start <= start && e->seen > start)
+			pc->hits++;
+		else if (!(e = proc_read(pc, ppid)) || e->start > start)
+			break;
+		chain[n++] = ppid;
+	}
+	return n;
+}
+
+void
+proc_stats(ProcCache *pc)
+{
+	fprintf(stderr, "proc: %u/%u processes cached, %lu hits, %lu reads, %lu scans\n",
+	        pc->count, pc->size, pc->hits, pc->reads, pc->scans);
+}
@@ -0,0 +1,59 @@
+/* See LICENSE file for copyright and license details. */
+
+#include <sys/types.h>
+
+/**
+ * @file proc.h
+ * @brief Cache of the process tree for swallow ancestry lookups
+ * @note Linux only, parses <root>/<pid>/stat
+ */
+
+typedef struct {
+	pid_t pid, ppid;
+	unsigned long long start; /* start time, clock ticks since boot */
+	unsigned long long seen;  /* when ppid was read, same unit */
+} ProcEntry;
+
+/**
+ * @brief pid -> ppid map filled by a scan of the proc root and refreshed
+ *        one pid at a time when a lookup misses
+ */
+typedef struct {
+	char root[64];
+	ProcEntry *tab;           /* open addressing, pid 0 marks a free slot */
+	unsigned int size, count;
+	unsigned long hits, reads, scans;
+} ProcCache;
+
+/**
+ * @brief Set up an empty cache
+ * @param pc Cache to initialize
+ * @param root Directory laid out like /proc, so the cache can be pointed
+ *        at a synthetic tree
+ */
+void proc_init(ProcCache *pc, const char *root);
+
+/**
+ * @brief Free the cache's table
+ * @param pc Cache to clear, usable again afterwards
+ */
+void proc_clear(ProcCache *pc);
+
+/**
+ * @brief Collect a process and its ancestors
+ * @param pc Cache to use
+ * @param pid Process to start from, always read afresh
+ * @param chain Receives pid, its parent, grandparent and so on
+ * @param max Capacity of chain
+ * @return Number of pids stored, 0 if pid does not exist
+ * @note A cached parent is only trusted if it started before the child and
+ *       was read after the child started, which rules out pid reuse; other
+ *       entries are read again
+ */
+int proc_ancestors(ProcCache *pc, pid_t pid, pid_t *chain, int max);
+
+/**
+ * @brief Print lookup statistics to stderr
+ * @param pc Cache to report on
+ */
+void proc_stats(ProcCache *pc);
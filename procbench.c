@@ -0,0 +1,173 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * procbench times swallow ancestry lookups against a synthetic proc tree:
+ *
+ *   make bench
+ *
+ * It lays out <tmpdir>/<pid>/stat for NTERMS terminals, each running a shell
+ * with CHILDREN chains of DEPTH processes, and looks up the ancestors of
+ * every leaf three ways: reading each stat file like the walk dwm did before
+ * the cache, with a cold ProcCache (one pass from empty, the scan included)
+ * and with the same cache warm.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "proc.h"
+#include "util.h"
+
+#define NTERMS   16
+#define CHILDREN 32
+#define DEPTH    6
+#define NPROCS   (2 + NTERMS * (2 + CHILDREN * DEPTH))
+#define ROUNDS   20
+
+static char root[] = "/tmp/procbench.XXXXXX";
+static pid_t parent[NPROCS + 1];
+static pid_t leaves[NTERMS * CHILDREN];
+static int nleaves, nprocs;
+
+static pid_t
+mkproc(pid_t pid, pid_t ppid)
+{
+	char path[sizeof(root) + 32];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "%s/%d", root, (int)pid);
+	if (mkdir(path, 0700) < 0)
+		die("procbench: mkdir %s:", path);
+	strcat(path, "/stat");
+	if (!(fp = fopen(path, "w")))
+		die("procbench: fopen %s:", path);
+	/* fields 1 to 22, comm with a space and a ')' like real ones may have */
+	fprintf(fp, "%d (a) b) S %d %d %d 0 -1 4194560 0 0 0 0 0 0 0 0 20 0 1 0 %d\n",
+	        (int)pid, (int)ppid, (int)pid, (int)pid, (int)pid);
+	fclose(fp);
+	parent[pid] = ppid;
+	nprocs++;
+	return pid;
+}
+
+static void
+mktree(void)
+{
+	pid_t pid = 1, term, shell, p;
+	int t, c, d;
+
+	if (!mkdtemp(root))
+		die("procbench: mkdtemp:");
+	mkproc(pid++, 0);
+	for (t = 0; t < NTERMS; t++) {
+		term = mkproc(pid++, 1);
+		shell = mkproc(pid++, term);
+		for (c = 0; c < CHILDREN; c++) {
+			for (p = shell, d = 0; d < DEPTH; d++)
+				p = mkproc(pid++, p);
+			leaves[nleaves++] = p;
+		}
+	}
+}
+
+static void
+rmtree(void)
+{
+	char path[sizeof(root) + 32];
+	pid_t pid;
+
+	for (pid = 1; pid <= nprocs; pid++) {
+		snprintf(path, sizeof(path), "%s/%d/stat", root, (int)pid);
+		unlink(path);
+		path[strlen(path) - 5] = '\0';
+		rmdir(path);
+	}
+	rmdir(root);
+}
+
+/* one fopen and fscanf per ancestor */
+static int
+naive(pid_t pid, pid_t *chain, int max)
+{
+	char path[sizeof(root) + 32];
+	FILE *fp;
+	int n = 0, ppid;
+
+	while (pid > 0 && n < max) {
+		snprintf(path, sizeof(path), "%s/%d/stat", root, (int)pid);
+		if (!(fp = fopen(path, "r")))
+			break;
+		if (fscanf(fp, "%*d (a) b) %*c %d", &ppid) != 1)
+			ppid = 0;
+		fclose(fp);
+		chain[n++] = pid;
+		pid = ppid;
+	}
+	return n;
+}
+
+static double
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void
+check(const pid_t *chain, int n, pid_t leaf)
+{
+	int i;
+
+	if (n != DEPTH + 3)
+		die("procbench: %d ancestors of %d, expected %d", n, (int)leaf, DEPTH + 3);
+	for (i = 1; i < n; i++)
+		if (chain[i] != parent[chain[i - 1]])
+			die("procbench: wrong parent of %d", (int)chain[i - 1]);
+}
+
+static void
+report(const char *name, double t, int n)
+{
+	printf("%-6s %8.2f us/lookup\n", name, t * 1e6 / n);
+	fflush(stdout);
+}
+
+int
+main(void)
+{
+	pid_t chain[64];
+	ProcCache pc;
+	double t;
+	int r, i;
+
+	mktree();
+	printf("%d processes, %d lookups of %d ancestors\n", NPROCS, ROUNDS * nleaves, DEPTH + 3);
+
+	t = now();
+	for (r = 0; r < ROUNDS; r++)
+		for (i = 0; i < nleaves; i++)
+			check(chain, naive(leaves[i], chain, LENGTH(chain)), leaves[i]);
+	report("naive", now() - t, ROUNDS * nleaves);
+
+	proc_init(&pc, root);
+	t = now();
+	for (i = 0; i < nleaves; i++)
+		check(chain, proc_ancestors(&pc, leaves[i], chain, LENGTH(chain)), leaves[i]);
+	report("cold", now() - t, nleaves);
+	proc_stats(&pc);
+
+	t = now();
+	for (r = 0; r < ROUNDS; r++)
+		for (i = 0; i < nleaves; i++)
+			check(chain, proc_ancestors(&pc, leaves[i], chain, LENGTH(chain)), leaves[i]);
+	report("warm", now() - t, ROUNDS * nleaves);
+	proc_stats(&pc);
+	proc_clear(&pc);
+
+	rmtree();
+	return 0;
+}
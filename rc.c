@@ -0,0 +1,510 @@
+/* Runtime configuration overlaid on config.h
+ *
+ * rcfile, relative to $XDG_CONFIG_HOME (or ~/.config), is read at startup
+ * and again whenever it changes. One directive per line, '#' starts a
+ * comment and "double quotes" keep spaces in a word:
+ *
+ *   key <mods+keysym> <command> [arg]  bind a key, replacing a compiled
+ *                                      binding of the same combination;
+ *                                      mods are Shift, Control, Mod1..Mod5,
+ *                                      Alt (Mod1) and Super (Mod4)
+ *   unbind <mods+keysym>               drop a compiled binding
+ *   rule <class> <instance> <title> <tags> <isfloating> <isterminal>
+ *        <noswallow> <monitor> [<x> <y> <w> <h> <floatborderpx>]
+ *                                      add a rule after the compiled ones,
+ *                                      "-" leaves a pattern unset
+ *   color <scheme> <fg> <bg> <border>  override a color scheme: norm, sel,
+ *                                      status, tagssel, tagsnorm, infosel,
+ *                                      infonorm; "-" keeps a color
+ *   gaps <ih> <iv> <oh> <ov>           set the gaps of every monitor
+ *
+ * Commands are looked up in commands[]; the argument is parsed by the
+ * command's type: a number, a tag (1..n, 0 for all), a layout index
+ * (layouts[], then the plugins in layoutdir), a shell command for spawn,
+ * or a key and a shell command for togglescratch.
+ *
+ * A file that fails to parse is reported on stderr and changes nothing.
+ */
+
+enum { ArgNone, ArgInt, ArgUint, ArgTag, ArgFloat, ArgLayout, ArgChar,
+       ArgCmd, ArgScratch }; /* command argument types */
+
+typedef struct {
+	const char *name;
+	void (*func)(const Arg *arg);
+	int argtype;
+} Command;
+
+typedef struct {
+	Key *keys;                       /* compiled keys with the file's applied */
+	unsigned int nkeys, keysize;
+	Rule *rules;                     /* compiled rules, then the file's */
+	unsigned int nrules, rulesize;
+	char colors[LENGTH(colors)][3][8]; /* "" keeps the compiled color */
+	int gaps[4], hasgaps;
+	void **allocs;                   /* strings and argv the tables point to */
+	unsigned int nallocs;
+} Rc;
+
+static int cmdarg(const Command *cmd, char *s, Arg *arg);
+static const Command *findcommand(const char *name);
+static void rcapply(Rc *rc);
+#ifdef __linux__
+static void rcevent(int fd, short revents);
+#endif /* __linux__ */
+static void rcfree(Rc *rc);
+static void rcinit(void);
+static int rcload(const char *path, Rc *rc);
+static void rcquit(void);
+static void rcreload(void);
+
+static const Command commands[] = {
+	{ "cyclelayout",      cyclelayout,      ArgInt },
+	{ "defaultgaps",      defaultgaps,      ArgNone },
+	{ "focusmaster",      focusmaster,      ArgNone },
+	{ "focusmon",         focusmon,         ArgInt },
+	{ "focusstack",       focusstack,       ArgInt },
+	{ "incnmaster",       incnmaster,       ArgInt },
+	{ "incrgaps",         incrgaps,         ArgInt },
+	{ "incrigaps",        incrigaps,        ArgInt },
+	{ "incrihgaps",       incrihgaps,       ArgInt },
+	{ "incrivgaps",       incrivgaps,       ArgInt },
+	{ "incrogaps",        incrogaps,        ArgInt },
+	{ "incrohgaps",       incrohgaps,       ArgInt },
+	{ "incrovgaps",       incrovgaps,       ArgInt },
+	{ "killclient",       killclient,       ArgUint },
+	{ "makescratchtagwin", makescratchtagwin, ArgChar },
+	{ "pushstack",        pushstack,        ArgInt },
+	{ "quit",             quit,             ArgInt },
+	{ "quitprompt",       quitprompt,       ArgNone },
+	{ "reloadlayouts",    reloadlayouts,    ArgNone },
+	{ "setlayout",        setlayout,        ArgLayout },
+	{ "setmfact",         setmfact,         ArgFloat },
+	{ "spawn",            spawn,            ArgCmd },
+	{ "tag",              tag,              ArgTag },
+	{ "tagmon",           tagmon,           ArgInt },
+	{ "togglebar",        togglebar,        ArgNone },
+	{ "togglebarcolor",   togglebarcolor,   ArgNone },
+	{ "togglebarfloat",   togglebarfloat,   ArgNone },
+	{ "togglebarlt",      togglebarlt,      ArgNone },
+	{ "togglebarstatus",  togglebarstatus,  ArgNone },
+	{ "togglebartags",    togglebartags,    ArgNone },
+	{ "togglebartitle",   togglebartitle,   ArgNone },
+	{ "togglefloating",   togglefloating,   ArgNone },
+	{ "togglefullscreen", togglefullscreen, ArgNone },
+	{ "togglegaps",       togglegaps,       ArgNone },
+	{ "togglescratch",    togglescratch,    ArgScratch },
+	{ "togglesticky",     togglesticky,     ArgNone },
+	{ "toggletag",        toggletag,        ArgTag },
+	{ "toggleview",       toggleview,       ArgTag },
+	{ "view",             view,             ArgTag },
+	{ "xrdb",             xrdb,             ArgNone },
+	{ "zoom",             zoom,             ArgNone },
+};
+
+static const char *schemenames[] = {
+	[SchemeNorm] = "norm", [SchemeSel] = "sel", [SchemeStatus] = "status",
+	[SchemeTagsSel] = "tagssel", [SchemeTagsNorm] = "tagsnorm",
+	[SchemeInfoSel] = "infosel", [SchemeInfoNorm] = "infonorm",
+};
+
+static const Key *keytab = keys;   /* bindings in effect */
+static unsigned int nkeytab = LENGTH(keys);
+static const Rule *ruletab = rules; /* rules in effect */
+static unsigned int nruletab = LENGTH(rules);
+static Rc rccur;                   /* tables keytab and ruletab point into */
+static char *defcolors[LENGTH(colors)][3]; /* colors[] before any override */
+static char rcpath[4096];
+static int rcfd = -1;
+
+/* next word of *s, NULL at the end of the line or a comment */
+static char *
+rcword(char **s)
+{
+	char *w, *p = *s;
+
+	while (*p == ' ' || *p == '\t')
+		p++;
+	if (!*p || *p == '#')
+		return NULL;
+	if (*p == '"') {
+		for (w = ++p; *p && *p != '"'; p++);
+	} else {
+		for (w = p; *p && *p != ' ' && *p != '\t'; p++);
+	}
+	if (*p)
+		*p++ = '\0';
+	*s = p;
+	return w;
+}
+
+static int
+rcnum(const char *s, long *n)
+{
+	char *end;
+
+	if (!s)
+		return -1;
+	*n = strtol(s, &end, 10);
+	return *end ? -1 : 0;
+}
+
+/* make rc own p, freed with it */
+static void *
+rckeep(Rc *rc, void *p)
+{
+	void **a;
+
+	if (!(a = realloc(rc->allocs, (rc->nallocs + 1) * sizeof(void *))))
+		die("realloc:");
+	rc->allocs = a;
+	return rc->allocs[rc->nallocs++] = p;
+}
+
+static void *
+rcgrow(void *p, unsigned int n, unsigned int *size, size_t elem)
+{
+	if (n < *size)
+		return p;
+	*size = *size ? *size * 2 : 16;
+	if (!(p = realloc(p, *size * elem)))
+		die("realloc:");
+	return p;
+}
+
+static char *
+rcstrdup(Rc *rc, const char *s)
+{
+	return strcpy(rckeep(rc, ecalloc(1, strlen(s) + 1)), s);
+}
+
+/* "Mod4+Shift+Return" */
+static int
+rccombo(char *s, unsigned int *mod, KeySym *sym)
+{
+	static const struct { const char *name; unsigned int mask; } mods[] = {
+		{ "Shift", ShiftMask }, { "Control", ControlMask }, { "Ctrl", ControlMask },
+		{ "Mod1", Mod1Mask }, { "Alt", Mod1Mask }, { "Mod2", Mod2Mask },
+		{ "Mod3", Mod3Mask }, { "Mod4", Mod4Mask }, { "Super", Mod4Mask },
+		{ "Mod5", Mod5Mask },
+	};
+	char *plus;
+	unsigned int i;
+
+	*mod = 0;
+	for (; s && (plus = strchr(s, '+')) && plus[1]; s = plus + 1) {
+		*plus = '\0';
+		for (i = 0; i < LENGTH(mods) && strcmp(mods[i].name, s); i++);
+		if (i == LENGTH(mods))
+			return -1;
+		*mod |= mods[i].mask;
+	}
+	return !s || (*sym = XStringToKeysym(s)) == NoSymbol ? -1 : 0;
+}
+
+const Command *
+findcommand(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < LENGTH(commands); i++)
+		if (!strcmp(commands[i].name, name))
+			return &commands[i];
+	return NULL;
+}
+
+/**
+ * @brief Parse a command's argument
+ * @param cmd Command the argument is for
+ * @param s Rest of the line, may be modified
+ * @param arg Receives the argument; for ArgCmd and ArgScratch arg->v is a
+ *        single allocation the caller frees
+ * @return 0, or -1 if s does not fit the argument type
+ */
+int
+cmdarg(const Command *cmd, char *s, Arg *arg)
+{
+	char **v, *w;
+	long n;
+	size_t len;
+
+	memset(arg, 0, sizeof(*arg));
+	while (*s == ' ' || *s == '\t')
+		s++;
+	switch (cmd->argtype) {
+	case ArgNone:
+		return 0;
+	case ArgInt:
+		if (rcnum(rcword(&s), &n) < 0)
+			return -1;
+		arg->i = n;
+		return 0;
+	case ArgUint:
+		if (rcnum(rcword(&s), &n) < 0 || n < 0)
+			return -1;
+		arg->ui = n;
+		return 0;
+	case ArgTag:
+		if (rcnum(rcword(&s), &n) < 0 || n < 0 || n > (long)LENGTH(tags))
+			return -1;
+		arg->ui = n ? 1 << (n - 1) : ~0;
+		return 0;
+	case ArgFloat:
+		if (!(w = rcword(&s)))
+			return -1;
+		arg->f = strtof(w, &w);
+		return *w ? -1 : 0;
+	case ArgLayout:
+		if (rcnum(rcword(&s), &n) < 0 || !(arg->v = layoutat(n)))
+			return -1;
+		return 0;
+	case ArgChar:
+		if (!(w = rcword(&s)) || w[1])
+			return -1;
+		arg->i = w[0];
+		return 0;
+	case ArgCmd:
+	case ArgScratch:
+		w = cmd->argtype == ArgScratch ? rcword(&s) : "";
+		if (!w || (cmd->argtype == ArgScratch && w[1]))
+			return -1;
+		while (*s == ' ' || *s == '\t')
+			s++;
+		if (!*s)
+			return -1;
+		/* { key, } "/bin/sh", "-c", command, NULL in one block */
+		len = strlen(s) + 1;
+		v = ecalloc(1, 5 * sizeof(char *) + len + 2);
+		n = 0;
+		if (cmd->argtype == ArgScratch) {
+			v[n] = (char *)(v + 5) + len;
+			v[n++][0] = w[0];
+		}
+		v[n++] = "/bin/sh";
+		v[n++] = "-c";
+		v[n++] = strcpy((char *)(v + 5), s);
+		arg->v = v;
+		return 0;
+	}
+	return -1;
+}
+
+/* read path into rc; 0 on success, a missing file counts as empty */
+int
+rcload(const char *path, Rc *rc)
+{
+	char buf[1024], *s, *w, *f[13];
+	const Command *cmd;
+	unsigned int mod, i, j, nf, lineno = 0;
+	KeySym sym;
+	Arg arg;
+	long n[10];
+	FILE *fp;
+
+	memset(rc, 0, sizeof(*rc));
+	rc->keys = rcgrow(NULL, 0, &rc->keysize, sizeof(Key));
+	for (i = 0; i < LENGTH(keys); i++) {
+		rc->keys = rcgrow(rc->keys, rc->nkeys, &rc->keysize, sizeof(Key));
+		memcpy(&rc->keys[rc->nkeys++], &keys[i], sizeof(Key));
+	}
+	rc->rules = rcgrow(NULL, 0, &rc->rulesize, sizeof(Rule));
+	for (i = 0; i < LENGTH(rules); i++) {
+		rc->rules = rcgrow(rc->rules, rc->nrules, &rc->rulesize, sizeof(Rule));
+		memcpy(&rc->rules[rc->nrules++], &rules[i], sizeof(Rule));
+	}
+	if (!path[0] || !(fp = fopen(path, "r")))
+		return 0;
+	while (fgets(buf, sizeof(buf), fp)) {
+		lineno++;
+		buf[strcspn(buf, "\n")] = '\0';
+		s = buf;
+		if (!(w = rcword(&s)))
+			continue;
+		if (!strcmp(w, "key") || !strcmp(w, "unbind")) {
+			if (rccombo(rcword(&s), &mod, &sym) < 0)
+				goto bad;
+			cmd = NULL;
+			if (w[0] == 'k' && (!(w = rcword(&s)) || !(cmd = findcommand(w))
+			|| cmdarg(cmd, s, &arg) < 0))
+				goto bad;
+			if (cmd && (cmd->argtype == ArgCmd || cmd->argtype == ArgScratch))
+				rckeep(rc, (void *)arg.v);
+			for (i = j = 0; i < rc->nkeys; i++) /* drop the same combination */
+				if (rc->keys[i].mod != mod || rc->keys[i].keysym != sym)
+					memcpy(&rc->keys[j++], &rc->keys[i], sizeof(Key));
+			rc->nkeys = j;
+			if (!cmd)
+				continue;
+			rc->keys = rcgrow(rc->keys, rc->nkeys, &rc->keysize, sizeof(Key));
+			memcpy(&rc->keys[rc->nkeys++], &(Key){ mod, sym, cmd->func, arg }, sizeof(Key));
+		} else if (!strcmp(w, "rule")) {
+			for (nf = 0; nf < LENGTH(f) && (f[nf] = rcword(&s)); nf++);
+			if ((nf != 8 && nf != 13) || rcword(&s))
+				goto bad;
+			for (i = 3; i < nf; i++) /* tags ... monitor, then x y w h floatborderpx */
+				if (rcnum(f[i], &n[i - 3]) < 0)
+					goto bad;
+			if (nf == 8)
+				n[5] = n[6] = n[7] = n[8] = n[9] = -1;
+			rc->rules = rcgrow(rc->rules, rc->nrules, &rc->rulesize, sizeof(Rule));
+			memcpy(&rc->rules[rc->nrules++], &(Rule){
+				strcmp(f[0], "-") ? rcstrdup(rc, f[0]) : NULL,
+				strcmp(f[1], "-") ? rcstrdup(rc, f[1]) : NULL,
+				strcmp(f[2], "-") ? rcstrdup(rc, f[2]) : NULL,
+				n[0] > 0 && n[0] <= (long)LENGTH(tags) ? 1 << (n[0] - 1) : 0,
+				n[1], n[2], n[3], n[4], n[5], n[6], n[7], n[8], n[9], 0 }, sizeof(Rule));
+		} else if (!strcmp(w, "color")) {
+			if (!(w = rcword(&s)))
+				goto bad;
+			for (i = 0; i < LENGTH(colors) && (i >= LENGTH(schemenames) || !schemenames[i]
+			|| strcmp(schemenames[i], w)); i++);
+			if (i == LENGTH(colors))
+				goto bad;
+			for (j = 0; j < 3; j++) {
+				if (!(w = rcword(&s)))
+					goto bad;
+				if (!strcmp(w, "-"))
+					continue;
+				if (w[0] != '#' || strlen(w) != 7 || strspn(w + 1, "0123456789abcdefABCDEF") != 6)
+					goto bad;
+				strcpy(rc->colors[i][j], w);
+			}
+		} else if (!strcmp(w, "gaps")) {
+			for (i = 0; i < 4; i++)
+				if (rcnum(rcword(&s), &n[i]) < 0 || n[i] < 0)
+					goto bad;
+			for (i = 0; i < 4; i++)
+				rc->gaps[i] = n[i];
+			rc->hasgaps = 1;
+		} else
+			goto bad;
+	}
+	fclose(fp);
+	return 0;
+bad:
+	fprintf(stderr, "dwm: %s:%u: cannot parse, keeping the current configuration\n", path, lineno);
+	fclose(fp);
+	rcfree(rc);
+	return -1;
+}
+
+void
+rcfree(Rc *rc)
+{
+	unsigned int i;
+
+	for (i = 0; i < rc->nallocs; i++)
+		free(rc->allocs[i]);
+	free(rc->allocs);
+	free(rc->keys);
+	free(rc->rules);
+	memset(rc, 0, sizeof(*rc));
+}
+
+/* switch to rc's tables; regrabs changed keys, rebuilds rules and schemes */
+void
+rcapply(Rc *rc)
+{
+	Monitor *m;
+	Client *c;
+	unsigned int i, j;
+
+	keytab = rc->keys;
+	nkeytab = rc->nkeys;
+	ruletab = rc->rules;
+	nruletab = rc->nrules;
+	rcfree(&rccur);
+	rccur = *rc;
+	grabkeys();
+	buildrules();
+	for (i = 0; i < LENGTH(colors); i++) {
+		for (j = 0; j < 3; j++)
+			colors[i][j] = rccur.colors[i][j][0] ? rccur.colors[i][j] : defcolors[i][j];
+		free(scheme[i]);
+		scheme[i] = drw_scm_create(drw, colors[i], 3);
+	}
+	for (m = mons; m; m = m->next) {
+		if (rccur.hasgaps) {
+			m->gappih = rccur.gaps[0];
+			m->gappiv = rccur.gaps[1];
+			m->gappoh = rccur.gaps[2];
+			m->gappov = rccur.gaps[3];
+		}
+		for (c = m->clients; c; c = c->next)
+			XSetWindowBorder(dpy, c->win, scheme[c == m->sel ? SchemeSel : SchemeNorm][ColBorder].pixel);
+	}
+	arrange(NULL);
+	drawbars();
+}
+
+void
+rcreload(void)
+{
+	Rc rc;
+
+	if (rcload(rcpath, &rc) == 0)
+		rcapply(&rc);
+}
+
+#ifdef __linux__
+void
+rcevent(int fd, short revents)
+{
+	char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+	const struct inotify_event *ev;
+	const char *name = strrchr(rcpath, '/') + 1;
+	ssize_t n;
+	char *p;
+	int changed = 0;
+
+	/* an editor saving the file sends several events, reload once */
+	while ((n = read(fd, buf, sizeof(buf))) > 0)
+		for (p = buf; p < buf + n; p += sizeof(*ev) + ev->len) {
+			ev = (const struct inotify_event *)p;
+			if (ev->len && !strcmp(ev->name, name))
+				changed = 1;
+		}
+	if (changed)
+		rcreload();
+}
+#endif /* __linux__ */
+
+void
+rcinit(void)
+{
+	unsigned int i, j;
+#ifdef __linux__
+	char *slash;
+#endif /* __linux__ */
+
+	for (i = 0; i < LENGTH(colors); i++)
+		for (j = 0; j < 3; j++)
+			defcolors[i][j] = colors[i][j];
+	if (!rcfile || configpath(rcpath, sizeof(rcpath), rcfile) < 0)
+		return;
+	rcreload();
+#ifdef __linux__
+	/* watch the directory, editors replace the file rather than write it */
+	slash = strrchr(rcpath, '/');
+	*slash = '\0';
+	if ((rcfd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) >= 0
+	&& inotify_add_watch(rcfd, rcpath, IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) >= 0)
+		watchfd(rcfd, POLLIN, rcevent);
+	else if (rcfd >= 0) {
+		close(rcfd);
+		rcfd = -1;
+	}
+	*slash = '/';
+#endif /* __linux__ */
+}
+
+void
+rcquit(void)
+{
+	if (rcfd >= 0) {
+		unwatchfd(rcfd);
+		close(rcfd);
+		rcfd = -1;
+	}
+	rcfree(&rccur);
+}
@@ -0,0 +1,187 @@
+/* See LICENSE file for copyright and license details. */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "sock.h"
+#include "util.h"
+
+#define READSIZE 4096
+#define LINEMAX  65536 /* longer lines are discarded */
+#define READMAX  16    /* reads per conn_read(), the rest waits for the next poll */
+
+int
+sock_path(char *buf, size_t size, const char *name)
+{
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	int n;
+
+	if (dir && *dir)
+		n = snprintf(buf, size, "%s/%s", dir, name);
+	else
+		n = snprintf(buf, size, "/tmp/%s-%u", name, (unsigned)getuid());
+	return n < 0 || (size_t)n >= size || (size_t)n >= sizeof(((struct sockaddr_un *)0)->sun_path) ? -1 : 0;
+}
+
+static int
+sock_addr(struct sockaddr_un *sa, const char *path)
+{
+	memset(sa, 0, sizeof(*sa));
+	sa->sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(sa->sun_path))
+		return -1;
+	strcpy(sa->sun_path, path);
+	return 0;
+}
+
+int
+sock_listen(const char *path)
+{
+	struct sockaddr_un sa;
+	int fd;
+
+	if (sock_addr(&sa, path) < 0)
+		return -1;
+	if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0)
+		return -1;
+	unlink(path);
+	if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0
+	|| chmod(path, S_IRUSR | S_IWUSR) < 0
+	|| listen(fd, SOMAXCONN) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+int
+sock_connect(const char *path)
+{
+	struct sockaddr_un sa;
+	int fd;
+
+	if (sock_addr(&sa, path) < 0)
+		return -1;
+	if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+		return -1;
+	if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+Conn *
+conn_accept(int fd, size_t outmax)
+{
+	Conn *c;
+	int cfd;
+
+	if ((cfd = accept(fd, NULL, NULL)) < 0)
+		return NULL;
+	if (fcntl(cfd, F_SETFL, fcntl(cfd, F_GETFL) | O_NONBLOCK) < 0
+	|| fcntl(cfd, F_SETFD, FD_CLOEXEC) < 0) {
+		close(cfd);
+		return NULL;
+	}
+	c = ecalloc(1, sizeof(Conn));
+	c->fd = cfd;
+	c->outmax = outmax;
+	return c;
+}
+
+void
+conn_free(Conn *c)
+{
+	if (!c)
+		return;
+	close(c->fd);
+	free(c->in);
+	free(c->out);
+	free(c);
+}
+
+static void
+reserve(char **buf, size_t *size, size_t need)
+{
+	char *p;
+
+	if (need <= *size)
+		return;
+	*size = MAX(need, *size * 2);
+	if (!(p = realloc(*buf, *size)))
+		die("realloc:");
+	*buf = p;
+}
+
+int
+conn_read(Conn *c, void (*func)(Conn *c, char *line))
+{
+	char *line, *nl;
+	size_t off;
+	ssize_t n;
+	int i;
+
+	for (i = 0; i < READMAX; i++) {
+		reserve(&c->in, &c->insize, c->inlen + READSIZE);
+		if ((n = read(c->fd, c->in + c->inlen, READSIZE)) == 0)
+			return -1;
+		if (n < 0)
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+		c->inlen += n;
+		off = 0;
+		if (c->discarding) { /* the rest of an overlong line */
+			if (!(nl = memchr(c->in, '\n', c->inlen))) {
+				c->inlen = 0;
+				continue;
+			}
+			c->discarding = 0;
+			off = nl - c->in + 1;
+		}
+		for (; (nl = memchr(c->in + off, '\n', c->inlen - off)); off = nl - c->in + 1) {
+			*nl = '\0';
+			line = c->in + off;
+			func(c, line);
+		}
+		memmove(c->in, c->in + off, c->inlen - off);
+		c->inlen -= off;
+		if (c->inlen > LINEMAX) {
+			c->inlen = 0;
+			c->discarding = 1;
+		}
+	}
+	return 0;
+}
+
+int
+conn_flush(Conn *c)
+{
+	ssize_t n;
+
+	while (c->outlen) {
+		if ((n = send(c->fd, c->out, c->outlen, MSG_NOSIGNAL)) < 0)
+			return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ? 0 : -1;
+		memmove(c->out, c->out + n, c->outlen - n);
+		c->outlen -= n;
+	}
+	return 0;
+}
+
+int
+conn_write(Conn *c, const char *buf, size_t len)
+{
+	if (c->outmax && c->outlen + len > c->outmax) {
+		c->dropped++;
+		return -1;
+	}
+	reserve(&c->out, &c->outsize, c->outlen + len);
+	memcpy(c->out + c->outlen, buf, len);
+	c->outlen += len;
+	return conn_flush(c);
+}
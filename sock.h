@@ -0,0 +1,93 @@
+/* See LICENSE file for copyright and license details. */
+
+#include <stddef.h>
+
+/**
+ * @file sock.h
+ * @brief Non-blocking local stream sockets with line framing
+ * @note Listening descriptors are meant to be multiplexed into dwm's event
+ *       loop with watchfd()
+ */
+
+/**
+ * @brief A connected peer with buffered input and bounded output
+ */
+typedef struct {
+	int fd;
+	char *in;             /* incomplete input line */
+	size_t inlen, insize;
+	int discarding;       /* dropping input up to the next newline */
+	char *out;            /* output not yet accepted by the kernel */
+	size_t outlen, outsize;
+	size_t outmax;        /* output kept at most, further writes are dropped */
+	unsigned long dropped;
+} Conn;
+
+/**
+ * @brief Build the path of a socket in the user's runtime directory
+ * @param buf Buffer receiving the path
+ * @param size Size of buf
+ * @param name File name of the socket
+ * @return 0 on success, -1 if the path does not fit
+ * @note Uses $XDG_RUNTIME_DIR, or /tmp with the uid appended to name
+ */
+int sock_path(char *buf, size_t size, const char *name);
+
+/**
+ * @brief Create a listening socket, replacing a stale one at path
+ * @param path Filesystem path of the socket
+ * @return Non-blocking, close-on-exec listening descriptor, or -1
+ */
+int sock_listen(const char *path);
+
+/**
+ * @brief Connect to a listening socket
+ * @param path Filesystem path of the socket
+ * @return Blocking connected descriptor, or -1
+ */
+int sock_connect(const char *path);
+
+/**
+ * @brief Accept a pending connection
+ * @param fd Listening descriptor
+ * @param outmax Output buffered for the peer at most, in bytes
+ * @return Newly allocated connection, or NULL if none was pending
+ */
+Conn *conn_accept(int fd, size_t outmax);
+
+/**
+ * @brief Close a connection and free its buffers
+ * @param c Connection to free, may be NULL
+ */
+void conn_free(Conn *c);
+
+/**
+ * @brief Read what is available and hand every complete line to func
+ * @param c Connection to read from
+ * @param func Called with each line, the newline replaced by a NUL
+ * @return 0 while the connection is usable, -1 on EOF or error
+ * @note Reads a bounded amount, what is left keeps the descriptor readable;
+ *       a line longer than 64 KiB is dropped up to its newline
+ * @warning func must not free c
+ */
+int conn_read(Conn *c, void (*func)(Conn *c, char *line));
+
+/**
+ * @brief Queue output and write as much of it as the socket accepts
+ * @param c Connection to write to
+ * @param buf Data to send
+ * @param len Length of buf
+ * @return 0 on success, -1 if the data was dropped or the peer is gone
+ * @note Data that would grow the queue beyond outmax is dropped whole and
+ *       counted in c->dropped
+ */
+int conn_write(Conn *c, const char *buf, size_t len);
+
+/**
+ * @brief Write queued output
+ * @param c Connection to flush
+ * @return 0 on success, -1 if the peer is gone
+ * @note c->outlen is non-zero afterwards if the socket would block; a peer
+ *       that has gone raises no SIGPIPE
+ */
+int conn_flush(Conn *c);
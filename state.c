@@ -0,0 +1,122 @@
+/* State snapshot in shared memory
+ *
+ * Tools that keep asking which windows are on which tag and monitor read it
+ * from a mapping instead, see dwmstate.h. dwm.c marks changes in statedirty,
+ * statepublish() rewrites the whole snapshot under the sequence lock once
+ * the X queue drains; readers never block dwm and dwm never waits for them.
+ */
+
+static void stateinit(void);
+static void statepublish(void);
+static void statequit(void);
+
+static DwmState *state;
+static char statepath[64];
+static int statedirty = 1;
+
+void
+stateinit(void)
+{
+	struct stat st;
+	const char *d;
+	int fd;
+
+	if (!statename)
+		return;
+	/* one object per user and display, a nested dwm gets its own */
+	d = strrchr(DisplayString(dpy), ':');
+	snprintf(statepath, sizeof(statepath), "/%s-%u-%d", statename, (unsigned)getuid(),
+		d ? atoi(d + 1) : 0);
+	if ((fd = shm_open(statepath, O_RDWR | O_CREAT, 0600)) >= 0
+	&& (fstat(fd, &st) < 0 || st.st_uid != getuid() || (st.st_mode & 077))) {
+		/* an existing object keeps its owner and mode, never publish
+		 * into one that someone else could read or write */
+		fprintf(stderr, "dwm: cannot share state as '%s': not private to this user\n", statepath);
+		close(fd);
+		return;
+	}
+	if (fd < 0
+	|| ftruncate(fd, sizeof(DwmState)) < 0
+	|| (state = mmap(NULL, sizeof(DwmState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		fprintf(stderr, "dwm: cannot share state as '%s': %s\n", statepath, strerror(errno));
+		if (fd >= 0) {
+			close(fd);
+			shm_unlink(statepath);
+		}
+		state = NULL;
+		return;
+	}
+	close(fd); /* the mapping keeps the object */
+	state->seq += state->seq & 1; /* left odd by a dwm that crashed writing */
+	state->magic = DWMSTATE_MAGIC;
+	state->abi = DWMSTATE_ABI;
+	state->ntags = LENGTH(tags);
+	state->live = 1;
+}
+
+void
+statepublish(void)
+{
+	DwmStateMonitor *sm;
+	DwmStateClient *sc;
+	unsigned int nm, nc = 0, off = 1;
+	size_t len;
+	Monitor *m;
+	Client *c;
+
+	if (!state || !statedirty)
+		return;
+	statedirty = 0;
+	state->seq++; /* odd, readers retry */
+	__sync_synchronize();
+	state->titles[0] = '\0'; /* offset 0 is the empty title */
+	state->truncated = 0;
+	state->selmon = 0;
+	for (m = mons, nm = 0; m && nm < DWMSTATE_MAXMONS; m = m->next, nm++) {
+		sm = &state->mons[nm];
+		*sm = (DwmStateMonitor){ m->mx, m->my, m->mw, m->mh, m->wx, m->wy, m->ww, m->wh,
+			m->num, m->tagset[m->seltags], -1, "" };
+		memcpy(sm->symbol, m->ltsymbol, sizeof(sm->symbol));
+		sm->symbol[sizeof(sm->symbol) - 1] = '\0';
+		if (m == selmon)
+			state->selmon = nm;
+		for (c = m->clients; c; c = c->next) {
+			if (nc == DWMSTATE_MAXCLIENTS) {
+				state->truncated = 1;
+				break;
+			}
+			if (c == m->sel)
+				sm->sel = nc;
+			sc = &state->clients[nc++];
+			*sc = (DwmStateClient){ c->win, c->tags, nm, 0, c->x, c->y, c->w, c->h, 0 };
+			sc->flags = (c->isfloating ? DWMSTATE_FLOATING : 0)
+				| (c->isfullscreen ? DWMSTATE_FULLSCREEN : 0)
+				| (c->isurgent ? DWMSTATE_URGENT : 0)
+				| (c->isfixed ? DWMSTATE_FIXED : 0)
+				| (c->issticky ? DWMSTATE_STICKY : 0)
+				| (ISVISIBLE(c) ? DWMSTATE_VISIBLE : 0)
+				| (c == selmon->sel ? DWMSTATE_FOCUSED : 0);
+			len = strlen(c->name) + 1;
+			if (off + len <= DWMSTATE_TITLESIZE) {
+				memcpy(state->titles + off, c->name, len);
+				sc->title = off;
+				off += len;
+			}
+		}
+	}
+	state->nmons = nm;
+	state->nclients = nc;
+	__sync_synchronize();
+	state->seq++; /* even, consistent again */
+}
+
+void
+statequit(void)
+{
+	if (!state)
+		return;
+	state->live = 0;
+	munmap(state, sizeof(DwmState));
+	shm_unlink(statepath);
+	state = NULL;
+}
@@ -0,0 +1,485 @@
+/* Status blocks pushed over a local socket
+ *
+ * Producers connect to statussock and send one command per line:
+ *
+ *   set <id> <sig> <color> <text>   set block id (0..MAXBLOCKS-1); sig is the
+ *                                   click id sent back, 0 for none; color is
+ *                                   "#rrggbb" or "-" for the status scheme
+ *   del <id>                        remove block id
+ *
+ * A click on a block with a non-zero sig is written back to its producer as
+ * "click <id> <sig> <button>". Blocks are removed when their producer
+ * disconnects; while any block is set the root window name is ignored.
+ *
+ * With statusengine set, the statusblocks from config.h take the first ids,
+ * which producers cannot set, and are updated from a one second timer
+ * instead: readers run in-process, commands asynchronously through runjob().
+ * A click reruns the block, with BLOCK_BUTTON set for commands like
+ * dwmblocks does.
+ */
+
+#define MAXBLOCKS      32
+#define MAXSTATUSCONNS 16
+#define STATUSOUTMAX   4096 /* unread click events kept per producer */
+
+/* compile-time check if all built-in blocks fit into the block table */
+struct NumBlocks { char limitexceeded[LENGTH(statusblocks) > MAXBLOCKS ? -1 : 1]; };
+
+typedef struct {
+	char *text;        /* NULL while the block is unset */
+	int w;             /* cached text width */
+	unsigned int sig;  /* click id sent back to the owner, 0 for none */
+	int hasfg;
+	Clr fg;            /* overrides the status scheme foreground if hasfg */
+	Conn *owner;
+} Block;
+
+static void drawblock(unsigned int i, int x, int w);
+static void drawblocks(Monitor *m);
+static void enginedone(Job *j);
+static void enginetick(int fd, short revents);
+static void engineupdate(unsigned int i, int button);
+static void setblock(unsigned int i, Conn *owner, unsigned int sig, const char *color, const char *text);
+static void statusaccept(int fd, short revents);
+static int statusblockat(int x);
+static void statusclick(int button);
+static void statusconn(int fd, short revents);
+static void statusdrop(Conn *c);
+static void statusflush(void);
+static void statusinit(void);
+static void statusline(Conn *c, char *line);
+static void statusquit(void);
+static int statuswidth(void);
+
+static Block blocks[MAXBLOCKS];
+static unsigned int nblocks;     /* blocks currently set */
+static unsigned int blocksdirty; /* blocks changed without changing width */
+static int blockslayout;         /* widths changed, the whole bar is redrawn */
+static int barleftw;             /* width of tags and layout symbol on selmon */
+static int statusblock = -1;     /* block under the last status click */
+static int statusfd = -1;
+static char statuspath[108];
+static Conn *statusconns[MAXSTATUSCONNS];
+static int enginefd = -1;
+static unsigned long engineticks;
+static unsigned long enginedue[LENGTH(statusblocks)];
+static Job *enginejobs[LENGTH(statusblocks)];
+
+void
+drawblock(unsigned int i, int x, int w)
+{
+	Clr scm[3];
+
+	memcpy(scm, scheme[SchemeStatus], sizeof(scm));
+	if (blocks[i].hasfg)
+		scm[ColFg] = blocks[i].fg;
+	drw_setscheme(drw, scm);
+	drw_text(drw, x, 0, w, bh, 0, blocks[i].text, 0);
+}
+
+/* draw the set blocks right-aligned, the last one padded like the status
+ * text; expects statusw to be current */
+void
+drawblocks(Monitor *m)
+{
+	unsigned int i, last;
+	int x = m->ww - statusw;
+
+	for (last = i = 0; i < MAXBLOCKS; i++)
+		if (blocks[i].text)
+			last = i;
+	for (i = 0; i < MAXBLOCKS; i++) {
+		if (!blocks[i].text)
+			continue;
+		drawblock(i, x, blocks[i].w + (i == last ? 2 : 0));
+		x += blocks[i].w;
+	}
+}
+
+int
+statuswidth(void)
+{
+	unsigned int i;
+	int w = 0;
+
+	for (i = 0; i < MAXBLOCKS; i++)
+		if (blocks[i].text)
+			w += blocks[i].w;
+	return nblocks ? w + 2 : 0;
+}
+
+int
+statusblockat(int x)
+{
+	unsigned int i;
+
+	x -= selmon->ww - statusw;
+	for (i = 0; i < MAXBLOCKS; i++) {
+		if (!blocks[i].text)
+			continue;
+		if (x < blocks[i].w)
+			return i;
+		x -= blocks[i].w;
+	}
+	return -1;
+}
+
+void
+statusclick(int button)
+{
+	Block *b;
+	char buf[64];
+	int n;
+
+	if (statusblock < 0 || !(b = &blocks[statusblock])->text || !b->sig)
+		return;
+	if (!b->owner) { /* built-in block */
+		engineupdate(statusblock, button);
+		statusflush();
+		return;
+	}
+	n = snprintf(buf, sizeof(buf), "click %d %u %d\n", statusblock, b->sig, button);
+	if (conn_write(b->owner, buf, n) == 0 && b->owner->outlen)
+		watchfd(b->owner->fd, POLLIN | POLLOUT, statusconn);
+}
+
+static void
+blockclear(Block *b)
+{
+	if (b->hasfg)
+		XftColorFree(dpy, DefaultVisual(dpy, screen), DefaultColormap(dpy, screen), &b->fg);
+	free(b->text);
+	memset(b, 0, sizeof(*b));
+	nblocks--;
+}
+
+void
+setblock(unsigned int i, Conn *owner, unsigned int sig, const char *color, const char *text)
+{
+	Block *b = &blocks[i];
+	int w;
+
+	if (!b->text) {
+		nblocks++;
+		b->owner = owner;
+		blockslayout = 1;
+	} else {
+		free(b->text);
+		if (b->hasfg)
+			XftColorFree(dpy, DefaultVisual(dpy, screen), DefaultColormap(dpy, screen), &b->fg);
+		if (!owner)
+			b->owner = NULL; /* the engine wins over any producer */
+	}
+	if (!(b->text = strdup(text)))
+		die("strdup:");
+	b->sig = sig;
+	b->hasfg = color && XftColorAllocName(dpy, DefaultVisual(dpy, screen),
+		DefaultColormap(dpy, screen), color, &b->fg);
+	if ((w = drw_fontset_getwidth(drw, b->text)) != b->w) {
+		b->w = w;
+		blockslayout = 1;
+	}
+	blocksdirty |= 1u << i;
+}
+
+void
+statusline(Conn *c, char *line)
+{
+	Block *b;
+	char *cmd, *id, *sig, *color, *text = NULL, *end = line + strlen(line);
+	unsigned long i;
+
+	if (!(cmd = strtok(line, " ")) || !(id = strtok(NULL, " ")))
+		return;
+	if ((i = strtoul(id, &id, 10)) >= MAXBLOCKS || *id)
+		return;
+	if (statusengine && i < LENGTH(statusblocks))
+		return; /* the engine's own blocks */
+	b = &blocks[i];
+	if (b->text && b->owner != c)
+		return; /* owned by another producer */
+	if (!strcmp(cmd, "del")) {
+		if (b->text) {
+			blockclear(b);
+			blockslayout = 1;
+		}
+		return;
+	}
+	if (strcmp(cmd, "set") || !(sig = strtok(NULL, " ")) || !(color = strtok(NULL, " ")))
+		return;
+	if (color + strlen(color) < end)
+		text = color + strlen(color) + 1; /* rest of the line, spaces kept */
+	setblock(i, c, strtoul(sig, NULL, 10), strcmp(color, "-") ? color : NULL, text ? text : "");
+}
+
+/* redraw what the last batch of lines changed, the whole bar only if the
+ * status width changed */
+void
+statusflush(void)
+{
+	unsigned int i, last;
+	int x, w, x0 = -1, x1 = 0;
+
+	if (!blockslayout && !blocksdirty)
+		return;
+	if (blockslayout || !nblocks) {
+		blockslayout = 0;
+		blocksdirty = 0;
+		if (nblocks) {
+			statusw = statuswidth();
+			drawbar(selmon);
+		} else
+			updatestatus();
+		return;
+	}
+	if (!selmon->showbar || !selmon->showstatus || selmon->ww - statusw < barleftw) {
+		blocksdirty = 0;
+		return; /* hidden, or partly covered by the tags */
+	}
+	for (last = i = 0; i < MAXBLOCKS; i++)
+		if (blocks[i].text)
+			last = i;
+	x = selmon->ww - statusw;
+	for (i = 0; i < MAXBLOCKS; i++) {
+		if (!blocks[i].text)
+			continue;
+		w = blocks[i].w + (i == last ? 2 : 0);
+		if (blocksdirty & 1u << i) {
+			drawblock(i, x, w);
+			if (x0 < 0)
+				x0 = x;
+			x1 = x + w;
+		}
+		x += blocks[i].w;
+	}
+	blocksdirty = 0;
+	if (x0 >= 0)
+		drw_map(drw, selmon->barwin, x0, 0, x1 - x0, bh);
+}
+
+void
+statusdrop(Conn *c)
+{
+	unsigned int i;
+
+	for (i = 0; i < MAXBLOCKS; i++)
+		if (blocks[i].text && blocks[i].owner == c) {
+			blockclear(&blocks[i]);
+			blockslayout = 1;
+		}
+	for (i = 0; i < MAXSTATUSCONNS; i++)
+		if (statusconns[i] == c)
+			statusconns[i] = NULL;
+	unwatchfd(c->fd);
+	conn_free(c);
+}
+
+void
+statusconn(int fd, short revents)
+{
+	Conn *c = NULL;
+	unsigned int i;
+
+	for (i = 0; i < MAXSTATUSCONNS && !c; i++)
+		if (statusconns[i] && statusconns[i]->fd == fd)
+			c = statusconns[i];
+	if (!c)
+		return;
+	if (((revents & POLLOUT) && conn_flush(c) < 0)
+	|| ((revents & (POLLIN | POLLHUP | POLLERR)) && conn_read(c, statusline) < 0)) {
+		statusdrop(c);
+		statusflush();
+		return;
+	}
+	watchfd(fd, POLLIN | (c->outlen ? POLLOUT : 0), statusconn);
+	statusflush();
+}
+
+void
+statusaccept(int fd, short revents)
+{
+	Conn *c;
+	unsigned int i;
+
+	while ((c = conn_accept(fd, STATUSOUTMAX))) {
+		for (i = 0; i < MAXSTATUSCONNS && statusconns[i]; i++);
+		if (i == MAXSTATUSCONNS || watchfd(c->fd, POLLIN, statusconn) < 0) {
+			conn_free(c);
+			continue;
+		}
+		statusconns[i] = c;
+	}
+}
+
+void
+enginedone(Job *j)
+{
+	char *nl;
+
+	enginejobs[j->id] = NULL;
+	if ((nl = strchr(j->out, '\n')))
+		*nl = '\0';
+	setblock(j->id, NULL, statusblocks[j->id].sig, NULL, j->out);
+	statusflush();
+}
+
+void
+engineupdate(unsigned int i, int button)
+{
+	const StatusBlock *sb = &statusblocks[i];
+	char buf[256], env[32];
+
+	if (sb->command) {
+		if (enginejobs[i])
+			return; /* previous run still going */
+		snprintf(env, sizeof(env), "BLOCK_BUTTON=%d", button);
+		enginejobs[i] = runjob(sb->command, button ? env : NULL, enginedone, i);
+	} else if (sb->reader && sb->reader(sb->arg, buf, sizeof(buf)) == 0)
+		setblock(i, NULL, sb->sig, NULL, buf);
+}
+
+void
+enginetick(int fd, short revents)
+{
+#ifdef __linux__
+	uint64_t n;
+	unsigned int i;
+
+	if (read(fd, &n, sizeof(n)) != sizeof(n))
+		return;
+	engineticks += n;
+	for (i = 0; i < LENGTH(statusblocks); i++)
+		if (statusblocks[i].interval && engineticks >= enginedue[i]) {
+			enginedue[i] = engineticks + statusblocks[i].interval;
+			engineupdate(i, 0);
+		}
+	statusflush();
+#endif /* __linux__ */
+}
+
+void
+statusinit(void)
+{
+	unsigned int i;
+#ifdef __linux__
+	struct itimerspec ts = { { 1, 0 }, { 1, 0 } };
+#endif /* __linux__ */
+
+	if (statusengine) {
+		for (i = 0; i < LENGTH(statusblocks); i++) {
+			enginedue[i] = statusblocks[i].interval;
+			engineupdate(i, 0);
+		}
+		statusflush();
+#ifdef __linux__
+		if ((enginefd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0
+		|| timerfd_settime(enginefd, 0, &ts, NULL) < 0)
+			fprintf(stderr, "dwm: cannot create status timer\n");
+		else
+			watchfd(enginefd, POLLIN, enginetick);
+#else
+		fprintf(stderr, "dwm: status block timers need timerfd, blocks update on click only\n");
+#endif /* __linux__ */
+	}
+	if (!statussock)
+		return;
+	if (sock_path(statuspath, sizeof(statuspath), statussock) < 0
+	|| (statusfd = sock_listen(statuspath)) < 0) {
+		fprintf(stderr, "dwm: cannot listen on status socket '%s'\n", statussock);
+		statuspath[0] = '\0';
+		return;
+	}
+	watchfd(statusfd, POLLIN, statusaccept);
+}
+
+void
+statusquit(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < MAXSTATUSCONNS; i++)
+		if (statusconns[i])
+			statusdrop(statusconns[i]);
+	if (enginefd >= 0) {
+		unwatchfd(enginefd);
+		close(enginefd);
+		enginefd = -1;
+	}
+	if (statusfd < 0)
+		return;
+	unwatchfd(statusfd);
+	close(statusfd);
+	unlink(statuspath);
+	statusfd = -1;
+}
+
+/* readers for built-in blocks: fill buf and return 0, or -1 to keep the
+ * previous text */
+static int
+readfile(const char *path, char *buf, size_t size)
+{
+	ssize_t n;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+		return -1;
+	n = read(fd, buf, size - 1);
+	close(fd);
+	if (n < 0)
+		return -1;
+	buf[n] = '\0';
+	return 0;
+}
+
+int
+rdbattery(const char *arg, char *buf, size_t size)
+{
+	char path[128], cap[16], st[32];
+
+	snprintf(path, sizeof(path), "/sys/class/power_supply/%s/capacity", arg ? arg : "BAT0");
+	if (readfile(path, cap, sizeof(cap)) < 0)
+		return -1;
+	snprintf(path, sizeof(path), "/sys/class/power_supply/%s/status", arg ? arg : "BAT0");
+	if (readfile(path, st, sizeof(st)) < 0)
+		st[0] = '\0';
+	snprintf(buf, size, "%d%%%s", atoi(cap), !strncmp(st, "Charging", 8) ? "+" : "");
+	return 0;
+}
+
+int
+rdclock(const char *arg, char *buf, size_t size)
+{
+	time_t t = time(NULL);
+	struct tm *tm;
+
+	if (!(tm = localtime(&t)) || !strftime(buf, size, arg ? arg : "%H:%M", tm))
+		return -1;
+	return 0;
+}
+
+int
+rdloadavg(const char *arg, char *buf, size_t size)
+{
+	char avg[64];
+	double a1, a5, a15;
+
+	if (readfile("/proc/loadavg", avg, sizeof(avg)) < 0
+	|| sscanf(avg, "%lf %lf %lf", &a1, &a5, &a15) != 3)
+		return -1;
+	snprintf(buf, size, "%.2f %.2f %.2f", a1, a5, a15);
+	return 0;
+}
+
+int
+rdmeminfo(const char *arg, char *buf, size_t size)
+{
+	char info[512], *p;
+	unsigned long total, avail;
+
+	if (readfile("/proc/meminfo", info, sizeof(info)) < 0
+	|| !(p = strstr(info, "MemTotal:")) || sscanf(p, "MemTotal: %lu", &total) != 1
+	|| !(p = strstr(info, "MemAvailable:")) || sscanf(p, "MemAvailable: %lu", &avail) != 1)
+		return -1;
+	snprintf(buf, size, "%.1f/%.1fG", (total - avail) / 1048576.0, total / 1048576.0);
+	return 0;
+}